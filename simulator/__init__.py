@@ -1,7 +1,12 @@
 """
 Numass single and double events simulation
+
+Importing the package only loads numpy. Plotting imports matplotlib and
+building the C++ extension imports torch on first use. Batch workers may
+use the `runtime` submodule alone
 """
 
 from . import cpp
+from . import runtime
 from . import signals
 from . import util
@@ -0,0 +1,180 @@
+"""!
+\brief Command line interface
+
+Run `python -m simulator --help` for the list of commands
+"""
+
+import argparse
+
+from . import cpp
+from . import util
+from . import watch as watcher
+
+def makeContext(args):
+    """!
+    \brief Build a simulation context from command line arguments
+    """
+    E, P = util.loadExperimentalSignal(args.spectrum)
+    signal = util.loadSignalShape(args.shape)
+
+    return cpp.get().SimulationContext(
+        E, P, signal,
+        args.left, args.right,
+        args.offset_min, args.offset_max,
+        args.seed
+    )
+
+def shard(args):
+    """!
+    \brief `shard` command: run one shard and save its mergeable state
+    """
+    context = makeContext(args)
+    state = cpp.get().runShard(context, args.rolls, args.index, args.shards, args.bins, args.border, args.sketch_k)
+    state.save(args.output)
+
+    print(f"Shard {args.index}/{args.shards}: rolls [{state.begin}, {state.end}) written to {args.output}")
+
+def merge(args):
+    """!
+    \brief `merge` command: merge shard states and report the result
+    """
+    state = cpp.get().mergeRunStates([ cpp.get().RunState.load(f) for f in args.states ])
+
+    if args.output is not None:
+        state.save(args.output)
+
+    if args.dump is not None:
+        hist = state.histogram
+        with open(args.dump, "w+") as histOutput:
+            for n, x in zip(hist.density(), hist.edges):
+                histOutput.write(f"{x}{args.dump_sep}{n}\n")
+
+    print(f"rolls={state.rolls}")
+    print(f"mean={state.mean()}, variance={state.variance()}")
+    print(f"border={state.border} left={state.counts.left}, right={state.counts.right}, ratio={state.counts.ratio()}")
+
+    for name, sketch in ( ( "integral", state.sketches.integral ), ( "amplitude", state.sketches.amplitude ) ):
+        values = sketch.quantiles(args.quantiles)
+        report = ", ".join(f"q{q}={x:.6g} (±{sketch.rankError(q):.2g} rank)" for q, x in zip(args.quantiles, values))
+        print(f"{name}: {report}")
+
+def watch(args):
+    """!
+    \brief `watch` command: keep a ratio-vs-HV table up to date with a data directory
+    """
+    table = watcher.RatioTable(
+        args.directory, util.loadSignalShape(args.shape),
+        args.left, args.right, args.border,
+        args.offset_min, args.offset_max,
+        args.rolls, args.seed, args.output
+    )
+    print(f"Watching {args.directory}, table in {table.output}")
+    watcher.watch(table, args.interval, args.once, args.poll)
+
+def table(args):
+    """!
+    \brief `table` command: precompute a ratio lookup table over a data directory
+    """
+    module = cpp.get()
+    hv, E, counts = watcher.loadHvSpectra(args.directory)
+    result = module.RatioTable.build(
+        hv, E, counts, util.loadSignalShape(args.shape),
+        args.lefts, args.rights, args.borders,
+        module.OffsetDistribution.uniform(args.offset_min, args.offset_max),
+        args.replicas, args.seed
+    )
+    result.save(args.output)
+    print(f"{len(hv)} HV x {len(args.lefts)} left x {len(args.rights)} right x {len(args.borders)} borders written to {args.output}")
+
+def query(args):
+    """!
+    \brief `query` command: interpolate a ratio from a table written by `table`
+    """
+    estimate = cpp.get().RatioTable.load(args.table).query(args.hv, args.left, args.right, args.border)
+    print(f"ratio={estimate.ratio:.6g} stat=±{estimate.statError:.2g} interp=±{estimate.interpError:.2g}")
+
+def build(args):
+    """!
+    \brief `build` command: compile the C++ extension ahead of time
+    """
+    cpp.build(args.real)
+    print(f"Built {cpp.CPP_MODULE_PATH}")
+
+def main():
+    parser = argparse.ArgumentParser(prog="python -m simulator", description=__doc__)
+    commands = parser.add_subparsers(required=True)
+
+    shardParser = commands.add_parser("shard", help="run one shard of a double overlap simulation")
+    shardParser.add_argument("--spectrum", required=True, help="Numass amplitude spectrum file")
+    shardParser.add_argument("--shape", default="task/Shape_Etalon.txt", help="signal shape file")
+    shardParser.add_argument("--left", type=float, default=6, help="left integration border relative to 9")
+    shardParser.add_argument("--right", type=float, default=42, help="right integration border relative to 9")
+    shardParser.add_argument("--offset-min", type=int, default=0, help="minimum second peak offset")
+    shardParser.add_argument("--offset-max", type=int, default=42, help="maximum second peak offset")
+    shardParser.add_argument("--seed", type=int, required=True, help="RNG seed, the same for every shard")
+    shardParser.add_argument("--rolls", type=int, default=10_000_000, help="total number of rolls over all shards")
+    shardParser.add_argument("--shards", type=int, required=True, help="number of shards")
+    shardParser.add_argument("--index", type=int, required=True, help="shard index in [0, shards)")
+    shardParser.add_argument("--bins", type=int, default=1001, help="number of histogram bins")
+    shardParser.add_argument("--border", type=float, default=213, help="integral border for the ratio")
+    shardParser.add_argument("--sketch-k", type=int, default=32, help="quantile sketch section size")
+    shardParser.add_argument("-o", "--output", required=True, help="state file to write")
+    shardParser.set_defaults(func=shard)
+
+    mergeParser = commands.add_parser("merge", help="merge shard states")
+    mergeParser.add_argument("states", nargs="+", help="state files written by `shard`")
+    mergeParser.add_argument("-o", "--output", help="merged state file to write")
+    mergeParser.add_argument("--dump", help="histogram file to write, same format as `SignalTester.plot`")
+    mergeParser.add_argument("--dump-sep", default=' ', help="histogram file separator")
+    mergeParser.add_argument(
+        "--quantiles", type=float, nargs="+", default=[ 0.5, 0.999, 0.9999 ],
+        help="integral and amplitude quantiles to report"
+    )
+    mergeParser.set_defaults(func=merge)
+
+    watchParser = commands.add_parser("watch", help="compute ratios of new runs in a data directory as they arrive")
+    watchParser.add_argument("directory", help="directory receiving `p*(30s)(HV1=*)` run files")
+    watchParser.add_argument("--shape", default="task/Shape_Etalon.txt", help="signal shape file")
+    watchParser.add_argument("--left", type=float, default=6, help="left integration border relative to 9")
+    watchParser.add_argument("--right", type=float, default=42, help="right integration border relative to 9")
+    watchParser.add_argument("--offset-min", type=int, default=0, help="minimum second peak offset")
+    watchParser.add_argument("--offset-max", type=int, default=42, help="maximum second peak offset")
+    watchParser.add_argument("--border", type=float, default=213, help="integral border for the ratio")
+    watchParser.add_argument("--rolls", type=int, default=0, help="rolls per HV point, 0 to compute ratios without rolling")
+    watchParser.add_argument("--seed", type=int, default=0, help="RNG seed when rolling")
+    watchParser.add_argument("-o", "--output", help="table file, `ratios.tsv` in the directory by default")
+    watchParser.add_argument("--interval", type=float, default=1.0, help="polling period, seconds")
+    watchParser.add_argument("--poll", action="store_true", help="poll the directory instead of using inotify")
+    watchParser.add_argument("--once", action="store_true", help="process the files already there and exit")
+    watchParser.set_defaults(func=watch)
+
+    tableParser = commands.add_parser("table", help="precompute ratios on an HV x window x border grid")
+    tableParser.add_argument("directory", help="directory with `p*(30s)(HV1=*)` run files, runs of one HV are summed")
+    tableParser.add_argument("--shape", default="task/Shape_Etalon.txt", help="signal shape file")
+    tableParser.add_argument("--lefts", type=float, nargs="+", default=[ 6 ], help="left integration borders, ascending")
+    tableParser.add_argument("--rights", type=float, nargs="+", default=[ 42 ], help="right integration borders, ascending")
+    tableParser.add_argument("--borders", type=float, nargs="+", required=True, help="ratio borders, ascending")
+    tableParser.add_argument("--offset-min", type=int, default=0, help="minimum second peak offset")
+    tableParser.add_argument("--offset-max", type=int, default=42, help="maximum second peak offset")
+    tableParser.add_argument("--replicas", type=int, default=0, help="bootstrap replicas for statistical errors")
+    tableParser.add_argument("--seed", type=int, default=0, help="bootstrap seed")
+    tableParser.add_argument("-o", "--output", required=True, help="table file to write")
+    tableParser.set_defaults(func=table)
+
+    queryParser = commands.add_parser("query", help="interpolate a ratio from a precomputed table")
+    queryParser.add_argument("table", help="table file written by `table`")
+    queryParser.add_argument("--hv", type=float, required=True, help="HV")
+    queryParser.add_argument("--left", type=float, default=6, help="left integration border relative to 9")
+    queryParser.add_argument("--right", type=float, default=42, help="right integration border relative to 9")
+    queryParser.add_argument("--border", type=float, required=True, help="integral border for the ratio")
+    queryParser.set_defaults(func=query)
+
+    buildParser = commands.add_parser("build", help="compile the C++ extension so that workers don't need torch")
+    buildParser.add_argument("--real", default=None, help="C++ real type, `double` by default")
+    buildParser.set_defaults(func=build)
+
+    args = parser.parse_args()
+    args.func(args)
+
+if __name__ == "__main__":
+    main()
@@ -1,11 +1,122 @@
+import glob
+import importlib.machinery
+import importlib.util
 import os
+import shutil
+import subprocess
+import tempfile
 
 CPP_BASE_PATH = f"{os.path.dirname(__file__)}/cpp"
-
-from torch.utils.cpp_extension import load
+CPP_BUILD_PATH = f"{CPP_BASE_PATH}/build"
+CPP_MODULE_PATH = f"{CPP_BUILD_PATH}/cpp.so"
+## \brief Records the real type the compiled extension was built with
+CPP_REAL_STAMP_PATH = f"{CPP_MODULE_PATH}.real"
+CPP_REAL = "double"
 
 __cppmod = None
 
+def prebuiltRealType():
+    """!
+    \brief Real type of the compiled extension, `None` if unknown
+    """
+    try:
+        with open(CPP_REAL_STAMP_PATH) as f:
+            return f.read().strip()
+    except OSError:
+        return None
+
+def isPrebuiltFresh(realType = None):
+    """!
+    \brief Whether the compiled extension exists, is newer than its sources
+           and was built for `realType` (`CPP_REAL` by default)
+    """
+    if not os.path.exists(CPP_MODULE_PATH):
+        return False
+    if prebuiltRealType() != (realType or CPP_REAL):
+        return False
+
+    sources = glob.glob(f"{CPP_BASE_PATH}/*.hh") + glob.glob(f"{CPP_BASE_PATH}/*.cc")
+    built = os.path.getmtime(CPP_MODULE_PATH)
+    return all(os.path.getmtime(s) <= built for s in sources)
+
+def loadPrebuilt(path=CPP_MODULE_PATH):
+    """!
+    \brief Load a compiled extension without torch
+
+    \throws ImportError if `path` isn't a loadable extension
+    """
+    loader = importlib.machinery.ExtensionFileLoader("cpp", path)
+    spec = importlib.util.spec_from_file_location("cpp", path, loader=loader)
+    if spec is None:
+        raise ImportError(f"Can't load C++ extension from {path}")
+
+    module = importlib.util.module_from_spec(spec)
+    loader.exec_module(module)
+    return module
+
+STDPAR_PROBE = """
+#include <algorithm>
+#include <execution>
+#include <vector>
+int main() {
+    std::vector<int> v(1 << 10, 1);
+    std::for_each(std::execution::par, v.begin(), v.end(), [] (int& x) { ++x; });
+    return v[0] == 2 ? 0 : 1;
+}
+"""
+
+def stdparFlags():
+    """!
+    \brief Compiler and linker flags enabling the `StdPar` backend, `None` if unavailable
+
+    Compiles and links a probe with the C++ compiler. libstdc++ runs parallel
+    algorithms on TBB when its headers are installed, then `-ltbb` is needed
+    """
+    compiler = os.environ.get("CXX") or shutil.which("c++") or shutil.which("g++")
+    if compiler is None:
+        return None
+
+    with tempfile.TemporaryDirectory() as directory:
+        source = os.path.join(directory, "probe.cc")
+        with open(source, "w") as f:
+            f.write(STDPAR_PROBE)
+
+        for libs in ( [], [ "-ltbb" ] ):
+            command = [ compiler, "-std=c++20", source, "-o", os.path.join(directory, "probe") ] + libs
+            if subprocess.run(command, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL).returncode == 0:
+                return [ "-DEDU28_STDPAR" ], libs
+    return None
+
+def build(realType = None):
+    """!
+    \brief Compile and load the C++ extension
+
+    Only this path imports torch, for its extension builder. The `StdPar`
+    backend is compiled in when the compiler supports parallel algorithms
+
+    \param realType Module real type
+    """
+    from torch.utils.cpp_extension import load
+
+    realType = realType or CPP_REAL
+
+    cflags, ldflags = stdparFlags() or ( [], [] )
+
+    print(f"Loading C++ submodule from {CPP_BASE_PATH}")
+    module = load(
+        name = "cpp",
+        build_directory = CPP_BUILD_PATH,
+        sources = f"{CPP_BASE_PATH}/extension.cc",
+        extra_cflags = [ f"-DREAL={realType} -O3 -std=c++20 -DNDEBUG -fopenmp" ] + cflags,
+        # The extension is plain pybind11, don't keep libtorch as a dependency
+        extra_ldflags = [ "-fopenmp", "-Wl,--as-needed" ] + ldflags,
+        verbose = False
+    )
+
+    with open(CPP_REAL_STAMP_PATH, "w") as f:
+        f.write(realType + "\n")
+    return module
+
 def get(realType = None):
     """!
     \brief Get C++ extension interface
@@ -14,11 +125,12 @@ def get(realType = None):
 
     \throws RuntimeError if called with arguments after the extension has been initialized
 
-    On the first call, compiles and loads the C++ extension module
+    On the first call, loads the compiled extension if it's up to date with its
+    sources and was built for `realType` (`CPP_REAL` if not given). Otherwise
+    compiles it first
     """
 
     global __cppmod
-    CPP_REAL = "double"
     if realType is not None:
         if __cppmod is not None:
             raise RuntimeError("Compile-time flags provided for an already loaded C++ extension")
@@ -26,13 +138,9 @@ def get(realType = None):
         print(f"Custom simulator C++ real type set to {realType}")
 
     if __cppmod is None:
-        print(f"Loading C++ submodule from {CPP_BASE_PATH}")
-        __cppmod = load(
-            name = "cpp",
-            build_directory = f"{CPP_BASE_PATH}/build",
-            sources = f"{CPP_BASE_PATH}/extension.cc",
-            extra_cflags = [ f"-DREAL={realType} -O3 -std=c++20 -DNDEBUG" ],
-            verbose = False
-        )
+        if isPrebuiltFresh(realType):
+            __cppmod = loadPrebuilt()
+        else:
+            __cppmod = build(realType)
 
     return __cppmod
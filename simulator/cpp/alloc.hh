@@ -0,0 +1,276 @@
+#pragma once
+
+// Standard library
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <new>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#if __has_include(<sys/mman.h>)
+#include <sys/mman.h>
+#endif
+
+#include "backend.hh"
+#include "base.hh"
+
+namespace edu28 {
+
+/**
+ * \brief Huge page use for large buffers, see \ref BulkAllocator
+ */
+enum class HugePages : std::uint8_t {
+    /// \brief Regular pages only
+    Off,
+    /// \brief Ask for transparent huge pages with `MADV_HUGEPAGE`
+    Transparent,
+    /// \brief Reserved huge pages (`MAP_HUGETLB`), transparent ones if none are left
+    Explicit
+};
+
+/// \brief Implementation detail namespace
+namespace detail {
+
+    /// \brief Alignment of every buffer, one cache line
+    constexpr std::size_t bufferAlignment = 64;
+    /// \brief Buffers from this size on are mapped, prefaulted and pooled
+    constexpr std::size_t largeBufferBytes = std::size_t{ 1 } << 20;
+    /// \brief Large buffer size granularity and alignment
+    constexpr std::size_t hugePageBytes = std::size_t{ 2 } << 20;
+    /// \brief Stride of the prefaulting writes, the smallest page size
+    constexpr std::size_t prefaultStride = 4096;
+
+    inline std::atomic<HugePages> hugePages{ HugePages::Transparent };
+    inline std::atomic<std::size_t> bufferPoolLimit{ std::size_t{ 1 } << 30 };
+
+    /**
+     * \brief Recycles large buffers across runs
+     *
+     * Fresh buffers are mapped at huge page alignment and faulted in by all
+     * workers at once instead of page by page by whoever writes first.
+     * Released buffers are kept while the idle ones fit into
+     * \ref getBufferPoolLimit() and handed out again for requests of a
+     * similar size: up to half as large again as requested.
+     */
+    class BufferPool {
+        std::mutex mutex;
+        /// \brief Idle buffers by size
+        std::multimap<std::size_t, void*> idle;
+        std::size_t idleBytes = 0;
+        /// \brief Size of every large buffer handed out
+        std::unordered_map<void*, std::size_t> live;
+
+        static void* map(std::size_t bytes) {
+#if defined(MAP_ANONYMOUS)
+            const auto mode = hugePages.load();
+
+#if defined(MAP_HUGETLB)
+            if (mode == HugePages::Explicit) {
+                void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+                if (p != MAP_FAILED) return p;
+            }
+#endif
+
+            // Over-map by a huge page and trim it so that the buffer is huge page aligned
+            const auto padded = (mode == HugePages::Off) ? bytes : bytes + hugePageBytes;
+            void* raw = mmap(nullptr, padded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (raw == MAP_FAILED) throw std::bad_alloc();
+            if (mode == HugePages::Off) return raw;
+
+            const auto address = reinterpret_cast<std::uintptr_t>(raw);
+            const auto aligned = (address + hugePageBytes - 1) & ~(hugePageBytes - 1);
+            const auto head = aligned - address;
+            if (head > 0) munmap(raw, head);
+            if (hugePageBytes - head > 0) munmap(reinterpret_cast<void*>(aligned + bytes), hugePageBytes - head);
+
+#if defined(MADV_HUGEPAGE)
+            madvise(reinterpret_cast<void*>(aligned), bytes, MADV_HUGEPAGE);
+#endif
+            return reinterpret_cast<void*>(aligned);
+#else
+            return ::operator new(bytes, std::align_val_t{ bufferAlignment });
+#endif
+        } // <-- map()
+
+        static void unmap(void* p, std::size_t bytes) {
+#if defined(MAP_ANONYMOUS)
+            munmap(p, bytes);
+#else
+            ::operator delete(p, bytes, std::align_val_t{ bufferAlignment });
+#endif
+        } // <-- unmap()
+
+        /// \brief Touch every page, each worker its own contiguous part
+        static void prefault(void* p, std::size_t bytes) {
+            auto* data = static_cast<volatile char*>(p);
+            const auto pages = (bytes + prefaultStride - 1) / prefaultStride;
+            parallelFor(
+                pages,
+                [data] (std::size_t, std::size_t start, std::size_t end) {
+                    for (auto i = start; i < end; ++i) data[i * prefaultStride] = 0;
+                }
+            );
+        } // <-- prefault()
+
+        BufferPool() = default;
+
+    public:
+        /// \brief The pool shared by every allocator
+        static BufferPool& global() {
+            // Never destroyed: buffers held by Python objects may be released
+            // after static destructors have run
+            static auto* pool = new BufferPool();
+            return *pool;
+        } // <-- global()
+
+        /**
+         * \brief A buffer of at least `bytes`, aligned to \ref bufferAlignment
+         *
+         * \throws std::bad_alloc
+         */
+        void* acquire(std::size_t bytes) {
+            if (bytes < largeBufferBytes) return ::operator new(bytes, std::align_val_t{ bufferAlignment });
+
+            const auto size = (bytes + hugePageBytes - 1) / hugePageBytes * hugePageBytes;
+            {
+                std::lock_guard lock(mutex);
+                const auto it = idle.lower_bound(size);
+                if (it != idle.end() && it->first <= size + size / 2) {
+                    const auto [ found, p ] = *it;
+                    idle.erase(it);
+                    idleBytes -= found;
+                    live.emplace(p, found);
+                    return p;
+                }
+            }
+
+            void* p = map(size);
+            prefault(p, size);
+
+            std::lock_guard lock(mutex);
+            live.emplace(p, size);
+            return p;
+        } // <-- acquire()
+
+        /**
+         * \brief Return a buffer from \ref acquire() of the same `bytes`
+         */
+        void release(void* p, std::size_t bytes) {
+            if (bytes < largeBufferBytes) {
+                ::operator delete(p, std::align_val_t{ bufferAlignment });
+                return;
+            }
+
+            std::unique_lock lock(mutex);
+            const auto it = live.find(p);
+            const auto size = it->second;
+            live.erase(it);
+
+            if (idleBytes + size <= bufferPoolLimit.load()) {
+                idle.emplace(size, p);
+                idleBytes += size;
+                return;
+            }
+
+            lock.unlock();
+            unmap(p, size);
+        } // <-- release()
+
+        /// \brief Unmap every idle buffer
+        void trim() {
+            std::multimap<std::size_t, void*> dropped;
+            {
+                std::lock_guard lock(mutex);
+                dropped.swap(idle);
+                idleBytes = 0;
+            }
+            for (const auto& [ size, p ] : dropped) unmap(p, size);
+        } // <-- trim()
+
+        /// \brief Bytes held by idle buffers
+        std::size_t idleSize() {
+            std::lock_guard lock(mutex);
+            return idleBytes;
+        } // <-- idleSize()
+    }; // <-- class BufferPool
+
+} // <-- namespace detail
+
+/**
+ * \brief Select huge page use for buffers mapped from now on
+ *
+ * Defaults to \ref HugePages::Transparent
+ */
+void setHugePages(HugePages mode) { detail::hugePages.store(mode); }
+
+/// \brief Huge page use for newly mapped buffers
+HugePages getHugePages() { return detail::hugePages.load(); }
+
+/**
+ * \brief Set how many bytes of released buffers are kept for reuse
+ *
+ * Defaults to 1 GiB. Lowering it doesn't drop buffers already kept, see
+ * \ref releaseBufferPool()
+ */
+void setBufferPoolLimit(std::size_t bytes) { detail::bufferPoolLimit.store(bytes); }
+
+/// \brief How many bytes of released buffers are kept for reuse
+std::size_t getBufferPoolLimit() { return detail::bufferPoolLimit.load(); }
+
+/// \brief Bytes currently kept for reuse
+std::size_t getBufferPoolSize() { return detail::BufferPool::global().idleSize(); }
+
+/// \brief Return every kept buffer to the system
+void releaseBufferPool() { detail::BufferPool::global().trim(); }
+
+/**
+ * \brief Allocator for bulk result and histogram storage
+ *
+ * Memory is 64-byte aligned. Buffers of 1 MiB and more come from the
+ * \ref detail::BufferPool: huge pages where available, prefaulted in
+ * parallel when fresh, recycled when released.
+ *
+ * Elements constructed without arguments are default-initialized, so
+ * `BulkVector<T>(n)` of a trivial `T` doesn't write every element once on
+ * the calling thread before the workers fill it. Pass a value to get
+ * zeroes: `BulkVector<T>(n, 0)`.
+ */
+template <typename T>
+struct BulkAllocator {
+    using value_type = T;
+
+    BulkAllocator() = default;
+    template <typename U>
+    BulkAllocator(const BulkAllocator<U>&) {}
+
+    T* allocate(std::size_t n) {
+        if (n > SIZE_MAX / sizeof(T)) throw std::bad_array_new_length();
+        return static_cast<T*>(detail::BufferPool::global().acquire(n * sizeof(T)));
+    } // <-- allocate()
+
+    void deallocate(T* p, std::size_t n) {
+        detail::BufferPool::global().release(p, n * sizeof(T));
+    } // <-- deallocate()
+
+    template <typename U, typename... Args>
+    void construct(U* p, Args&&... args) {
+        if constexpr (sizeof...(Args) == 0) {
+            ::new (static_cast<void*>(p)) U;
+        } else {
+            ::new (static_cast<void*>(p)) U(std::forward<Args>(args)...);
+        }
+    } // <-- construct()
+
+    template <typename U>
+    bool operator==(const BulkAllocator<U>&) const { return true; }
+}; // <-- struct BulkAllocator
+
+/// \brief Vector in \ref BulkAllocator storage
+template <typename T>
+using BulkVector = std::vector<T, BulkAllocator<T>>;
+
+} // <-- namespace edu28
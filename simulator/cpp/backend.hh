@@ -0,0 +1,395 @@
+#pragma once
+
+// Standard library
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// libstdc++ implements parallel algorithms on top of TBB when it is installed,
+// which then has to be linked in. Opt in with -DEDU28_STDPAR, which cpp.build()
+// passes after probing the compiler
+#if defined(EDU28_STDPAR) && __has_include(<execution>)
+#include <execution>
+#define EDU28_HAS_STDPAR
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "base.hh"
+
+namespace edu28 {
+
+/**
+ * \brief Parallel execution backend used by the bulk helpers
+ */
+enum class Backend {
+    /// \brief Persistent `std::thread` pool owned by the module
+    Threads,
+    /// \brief OpenMP parallel loop. Shares the host application's OpenMP runtime
+    OpenMP,
+    /// \brief C++17 parallel algorithms
+    StdPar,
+}; // <-- enum class Backend
+
+/// \brief Implementation detail namespace
+namespace detail {
+
+    /**
+     * \brief First exception thrown by the chunks of a parallel job
+     *
+     * Chunks run through \ref call(), which never throws. Once one has
+     * failed the others are skipped, and the submitting thread rethrows
+     * after every chunk that was already running has finished.
+     */
+    class ChunkErrors {
+        std::mutex mutex;
+        std::exception_ptr first;
+        std::atomic<bool> failed{ false };
+
+    public:
+        /// \brief Run `func()` unless a chunk has failed, keep its exception if it throws
+        template <typename Func>
+        void call(Func&& func) noexcept {
+            if (failed.load(std::memory_order_relaxed)) return;
+
+            try {
+                func();
+            } catch (...) {
+                std::lock_guard lock(mutex);
+                if (!first) first = std::current_exception();
+                failed.store(true, std::memory_order_relaxed);
+            }
+        } // <-- call()
+
+        /// \brief Rethrow the first exception, if any. Call once all chunks are done
+        void rethrow() {
+            if (first) std::rethrow_exception(first);
+        } // <-- rethrow()
+    }; // <-- class ChunkErrors
+
+} // <-- namespace detail
+
+/**
+ * \brief Persistent thread pool
+ *
+ * Several jobs may run at once: idle workers take chunks from any active
+ * job, and the submitting thread always works on its own job, so a job
+ * completes even if every worker is busy (or blocked) elsewhere.
+ *
+ * A task that throws stops the job: chunks not started yet are skipped and
+ * the exception is rethrown by \ref run() once the running ones finish.
+ */
+class ThreadPool {
+    struct Job {
+        std::function<void(std::size_t)> task;
+        std::size_t count;
+        std::atomic<std::size_t> next{ 0 };
+        std::atomic<std::size_t> done{ 0 };
+        detail::ChunkErrors errors;
+
+        /// \brief Claim and run one chunk. Returns `false` if nothing is left
+        bool runOne() {
+            const auto i = next.fetch_add(1, std::memory_order_relaxed);
+            if (i >= count) return false;
+
+            errors.call([this, i] { task(i); });
+
+            done.fetch_add(1, std::memory_order_release);
+            done.notify_all();
+            return true;
+        } // <-- runOne()
+    }; // <-- struct Job
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<std::shared_ptr<Job>> jobs;
+    bool stopping = false;
+    std::vector<std::thread> workers;
+
+    void workerLoop() {
+        for (;;) {
+            std::shared_ptr<Job> job;
+            {
+                std::unique_lock lock(mutex);
+                cv.wait(lock, [this] { return stopping || !jobs.empty(); });
+                if (stopping) return;
+
+                job = jobs.front();
+                if (job->next.load(std::memory_order_relaxed) >= job->count) {
+                    jobs.pop_front();
+                    continue;
+                }
+            }
+
+            job->runOne();
+        }
+    } // <-- workerLoop()
+
+public:
+    /**
+     * \brief Start the pool
+     *
+     * \param size - number of worker threads (not counting submitting threads)
+     */
+    explicit ThreadPool(std::size_t size) {
+        for (std::size_t i = 0; i < size; ++i) {
+            workers.emplace_back([this] { workerLoop(); });
+        }
+    } // <-- ThreadPool()
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    ~ThreadPool() {
+        {
+            std::lock_guard lock(mutex);
+            stopping = true;
+        }
+        cv.notify_all();
+        for (auto& t : workers) t.join();
+    } // <-- ~ThreadPool()
+
+    /// \brief Number of worker threads
+    std::size_t size() const { return workers.size(); }
+
+    /**
+     * \brief Run `task(i)` for every `i` in [0, count) and wait for completion
+     *
+     * \throws the first exception thrown by `task`, after every running chunk is done
+     */
+    void run(std::size_t count, std::function<void(std::size_t)> task) {
+        auto job = std::make_shared<Job>();
+        job->task = std::move(task);
+        job->count = count;
+
+        {
+            std::lock_guard lock(mutex);
+            jobs.push_back(job);
+        }
+        cv.notify_all();
+
+        while (job->runOne()) {}
+
+        {
+            std::lock_guard lock(mutex);
+            if (auto it = std::find(jobs.begin(), jobs.end(), job); it != jobs.end()) jobs.erase(it);
+        }
+
+        for (auto done = job->done.load(std::memory_order_acquire); done < count; done = job->done.load(std::memory_order_acquire)) {
+            job->done.wait(done, std::memory_order_acquire);
+        }
+
+        job->errors.rethrow();
+    } // <-- run()
+
+    /// \brief Module-wide pool, started on first use
+    static ThreadPool& global() {
+        static ThreadPool pool(std::max(std::thread::hardware_concurrency(), 1u) - 1);
+        return pool;
+    } // <-- global()
+}; // <-- class ThreadPool
+
+/// \brief Implementation detail namespace
+namespace detail {
+
+    inline std::atomic<Backend> backend{ Backend::Threads };
+    inline std::atomic<std::size_t> concurrency{ std::max(std::thread::hardware_concurrency(), 1u) };
+
+} // <-- namespace detail
+
+/**
+ * \brief Select the bulk execution backend
+ *
+ * \throws std::runtime_error if the backend wasn't compiled in
+ */
+void setBackend(Backend backend) {
+#ifndef _OPENMP
+    if (backend == Backend::OpenMP) {
+        throw std::runtime_error("The module was built without OpenMP support");
+    }
+#endif
+#ifndef EDU28_HAS_STDPAR
+    if (backend == Backend::StdPar) {
+        throw std::runtime_error("The module was built without C++17 parallel algorithms support");
+    }
+#endif
+    detail::backend.store(backend);
+} // <-- void setBackend()
+
+/// \brief Currently selected bulk execution backend
+Backend getBackend() { return detail::backend.load(); }
+
+/**
+ * \brief Set the number of chunks bulk work is split into
+ *
+ * Also the OpenMP thread count when \ref Backend::OpenMP is selected.
+ * Defaults to the hardware concurrency
+ */
+void setConcurrency(std::size_t concurrency) {
+    detail::concurrency.store(std::max<std::size_t>(concurrency, 1));
+} // <-- void setConcurrency()
+
+/// \brief Number of chunks bulk work is split into
+std::size_t getConcurrency() { return detail::concurrency.load(); }
+
+namespace detail {
+
+    /// \brief [start, end) of chunk `chunk` when [0, size) is split into `chunks`
+    std::pair<std::size_t, std::size_t> chunkRange(std::size_t size, std::size_t chunks, std::size_t chunk) {
+        const std::size_t start = chunk * (size / chunks);
+        const std::size_t end = (chunk == chunks - 1) ? size : (start + size / chunks);
+        return { start, end };
+    } // <-- chunkRange()
+
+    /**
+     * \brief Split [0, size) into `chunks` contiguous chunks and run
+     *        `func(chunk, begin, end)` for each one on the selected backend
+     *
+     * Chunk boundaries only depend on `size` and `chunks`, not on the backend.
+     *
+     * \throws the first exception thrown by `func`. Chunks that haven't
+     *         started by then are skipped, running ones are waited for
+     */
+    template <typename Func>
+    void parallelFor(std::size_t size, std::size_t chunks, Func&& func) {
+        ChunkErrors errors;
+        const auto runChunk = [size, chunks, &func, &errors] (std::size_t chunk) {
+            errors.call([&] {
+                const auto [start, end] = chunkRange(size, chunks, chunk);
+                func(chunk, start, end);
+            });
+        };
+
+        switch (getBackend()) {
+#ifdef _OPENMP
+        case Backend::OpenMP:
+            #pragma omp parallel for schedule(static) num_threads(chunks)
+            for (std::size_t chunk = 0; chunk < chunks; ++chunk) runChunk(chunk);
+            break;
+#endif
+#ifdef EDU28_HAS_STDPAR
+        case Backend::StdPar: {
+            std::vector<std::size_t> ids(chunks);
+            std::iota(ids.begin(), ids.end(), 0);
+            // `par`, not `par_unseq`: roll functions keep thread-local RNG state,
+            // which unsequenced execution isn't allowed to touch
+            std::for_each(std::execution::par, ids.begin(), ids.end(), runChunk);
+            break;
+        }
+#endif
+        default:
+            ThreadPool::global().run(chunks, runChunk);
+        }
+
+        errors.rethrow();
+    } // <-- parallelFor()
+
+    /**
+     * \brief Most threads \ref parallelFor() can run `chunks` chunks on with
+     *        the selected backend
+     *
+     * The submitting thread plus the pool workers for \ref Backend::Threads,
+     * the OpenMP thread limit, or the hardware concurrency the parallel
+     * algorithms schedule on
+     */
+    std::size_t parallelThreads(std::size_t chunks) {
+        std::size_t threads = chunks;
+        switch (getBackend()) {
+#ifdef _OPENMP
+        case Backend::OpenMP:
+            // `num_threads(chunks)` overrides omp_get_max_threads()
+            threads = static_cast<std::size_t>(std::max(omp_get_thread_limit(), 1));
+            break;
+#endif
+#ifdef EDU28_HAS_STDPAR
+        case Backend::StdPar:
+            threads = std::max(std::thread::hardware_concurrency(), 1u);
+            break;
+#endif
+        default:
+            threads = ThreadPool::global().size() + 1;
+        }
+        return std::min(threads, chunks);
+    } // <-- parallelThreads()
+
+    /**
+     * \brief \ref parallelFor() on `pool` instead of the selected backend
+     *
+     * For long-lived work that would otherwise hold the workers of
+     * \ref ThreadPool::global() the other bulk calls rely on
+     */
+    template <typename Func>
+    void parallelFor(ThreadPool& pool, std::size_t size, std::size_t chunks, Func&& func) {
+        pool.run(
+            chunks,
+            [size, chunks, &func] (std::size_t chunk) {
+                const auto [start, end] = chunkRange(size, chunks, chunk);
+                func(chunk, start, end);
+            }
+        );
+    } // <-- parallelFor()
+
+    /**
+     * \brief \ref parallelFor() with \ref getConcurrency() chunks
+     */
+    template <typename Func>
+    void parallelFor(std::size_t size, Func&& func) {
+        parallelFor(size, getConcurrency(), std::forward<Func>(func));
+    } // <-- parallelFor()
+
+    /**
+     * \brief Fill one accumulator per block in parallel and merge them in block order
+     *
+     * Blocks are processed in waves of `chunks` so that only that many
+     * accumulators exist at once. Since every block is filled by one
+     * thread and merged in order, the result doesn't depend on the backend or
+     * the thread count even for accumulators whose merge isn't associative.
+     *
+     * \param blocks - number of blocks
+     * \param chunks - blocks per wave
+     * \param empty  - accumulator every block starts from
+     * \param work   - `work(accumulator, chunk, block)`, `chunk` is in [0, chunks)
+     * \param merge  - `merge(accumulator)`, called in block order
+     */
+    template <typename Accumulator, typename Work, typename Merge>
+    void orderedBlocks(std::size_t blocks, std::size_t chunks, const Accumulator& empty, Work&& work, Merge&& merge) {
+        chunks = std::max<std::size_t>(chunks, 1);
+
+        for (std::size_t first = 0; first < blocks; first += chunks) {
+            const auto wave = std::min(chunks, blocks - first);
+
+            std::vector<Accumulator> partial(wave, empty);
+            parallelFor(
+                wave, wave,
+                [first, &partial, &work] (std::size_t chunk, std::size_t, std::size_t) {
+                    work(partial[chunk], chunk, first + chunk);
+                }
+            );
+
+            for (const auto& p : partial) merge(p);
+        }
+    } // <-- orderedBlocks()
+
+    /**
+     * \brief \ref orderedBlocks() in waves of \ref getConcurrency()
+     */
+    template <typename Accumulator, typename Work, typename Merge>
+    void orderedBlocks(std::size_t blocks, const Accumulator& empty, Work&& work, Merge&& merge) {
+        orderedBlocks(blocks, getConcurrency(), empty, std::forward<Work>(work), std::forward<Merge>(merge));
+    } // <-- orderedBlocks()
+
+} // <-- namespace detail
+
+} // <-- namespace edu28
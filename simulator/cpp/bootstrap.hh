@@ -0,0 +1,226 @@
+#pragma once
+
+// Standard library
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "backend.hh"
+#include "base.hh"
+#include "budget.hh"
+#include "context.hh"
+#include "prob.hh"
+#include "rng.hh"
+#include "serial.hh"
+
+namespace edu28 {
+
+/**
+ * \brief Pile-up ratios of bootstrap replicas of a spectrum
+ */
+struct BootstrapResult {
+    /// \brief Ratio of every replica, in replica order
+    std::vector<Real> ratios;
+
+    /**
+     * \brief Mean ratio
+     *
+     * \throws std::runtime_error if there are no ratios
+     */
+    double mean() const {
+        if (ratios.empty()) throw std::runtime_error("BootstrapResult has no ratios");
+
+        double ret = 0;
+        for (auto r : ratios) ret += r;
+        return ret / static_cast<double>(ratios.size());
+    } // <-- mean()
+
+    /**
+     * \brief Sample standard deviation of the ratios
+     *
+     * \throws std::runtime_error if there are less than two ratios
+     */
+    double stddev() const {
+        if (ratios.size() < 2) throw std::runtime_error("BootstrapResult needs at least two ratios for a standard deviation");
+
+        const auto m = mean();
+        double ret = 0;
+        for (auto r : ratios) ret += (r - m) * (r - m);
+        return std::sqrt(ret / static_cast<double>(ratios.size() - 1));
+    } // <-- stddev()
+
+    /**
+     * \brief Ratio quantile, linear between order statistics
+     *
+     * \param q - probability in [0, 1]
+     *
+     * \throws std::runtime_error if there are no ratios
+     */
+    double quantile(double q) const {
+        if (ratios.empty()) throw std::runtime_error("BootstrapResult has no ratios");
+
+        auto sorted = ratios;
+        std::sort(sorted.begin(), sorted.end());
+
+        const auto pos = std::clamp(q, 0.0, 1.0) * static_cast<double>(sorted.size() - 1);
+        const auto idx = std::min(static_cast<std::size_t>(pos), sorted.size() - 1);
+        if (idx + 1 >= sorted.size()) return sorted.back();
+        return sorted[idx] + (pos - static_cast<double>(idx)) * (sorted[idx + 1] - sorted[idx]);
+    } // <-- quantile()
+
+    void save(BinaryWriter& w) const {
+        w.write(ratios);
+    } // <-- save()
+
+    static BootstrapResult load(BinaryReader& r) {
+        return BootstrapResult{ r.readVector<Real>() };
+    } // <-- load()
+}; // <-- struct BootstrapResult
+
+/**
+ * \brief Poisson bootstrap of a measured amplitude spectrum
+ *
+ * Replica number `i` redraws every channel count from a Poisson
+ * distribution with the measured count as its mean, using
+ * \ref CounterRng `(seed, i)`. Replicas are thus reproducible one by one
+ * and independent of the backend or thread count.
+ */
+class SpectrumBootstrap {
+    std::vector<Real> E;
+    std::vector<Real> counts;
+    std::uint64_t seed = 0;
+
+public:
+    /**
+     * \param E      - spectrum grid
+     * \param counts - raw (not normalized) counts at grid points
+     * \param seed   - RNG seed
+     *
+     * \throws std::runtime_error if `E` and `counts` sizes differ, the grid has
+     *         less than two points or a count is negative
+     */
+    SpectrumBootstrap(std::vector<Real> E, std::vector<Real> counts, std::uint64_t seed = randomSeed())
+        : E(std::move(E)), counts(std::move(counts)), seed(seed)
+    {
+        if (this->E.size() != this->counts.size() || this->E.size() < 2) {
+            throw std::runtime_error("SpectrumBootstrap expects `E` and `counts` of the same size of at least 2");
+        }
+        if (std::any_of(this->counts.begin(), this->counts.end(), [] (Real c) { return !(c >= 0); })) {
+            throw std::runtime_error("SpectrumBootstrap expects non-negative counts");
+        }
+    } // <-- SpectrumBootstrap()
+
+    /// \brief Spectrum grid
+    const std::vector<Real>& grid() const { return E; }
+    /// \brief Measured counts
+    const std::vector<Real>& getCounts() const { return counts; }
+    /// \brief RNG seed
+    std::uint64_t getSeed() const { return seed; }
+
+    /**
+     * \brief Write the counts of replica `index` into `out`
+     */
+    void replicaInto(std::size_t index, Real* out) const {
+        CounterRng rng(seed, index);
+        for (std::size_t i = 0; i < counts.size(); ++i) {
+            out[i] = static_cast<Real>(rng.poisson(counts[i]));
+        }
+    } // <-- replicaInto()
+
+    /// \brief Counts of replica `index`
+    std::vector<Real> replica(std::size_t index) const {
+        std::vector<Real> ret(counts.size());
+        replicaInto(index, ret.data());
+        return ret;
+    } // <-- replica()
+
+    /**
+     * \brief Counts of replicas [0, replicas), row-major `replicas x grid size`
+     *
+     * \throws MemoryBudgetExceeded if the result doesn't fit into the memory budget
+     */
+    std::vector<Real> replicas(std::size_t replicas) const {
+        const auto cols = counts.size();
+        detail::checkMemoryBudget(
+            detail::bytesFor<Real>(replicas) * cols,
+            "SpectrumBootstrap::replicas() of " + std::to_string(replicas) + " replicas"
+        );
+
+        std::vector<Real> ret(replicas * cols);
+        detail::parallelFor(
+            replicas,
+            [this, cols, &ret] (std::size_t, std::size_t start, std::size_t end) {
+                for (auto i = start; i < end; ++i) replicaInto(i, ret.data() + i * cols);
+            }
+        );
+
+        return ret;
+    } // <-- replicas()
+
+    /**
+     * \brief Pile-up ratio of every replica for `border`
+     *
+     * Each replica gets its own amplitude distribution in `base`'s tables
+     * (see \ref SimulationContext::withAmplitudes()). Replicas run in
+     * parallel, one replica per task.
+     *
+     * \param base   - simulation setup. Its amplitude distribution is replaced
+     * \param rolls  - rolls per replica. Zero computes the ratio without rolling,
+     *                 see \ref SimulationContext::analyticRatio(). Otherwise every
+     *                 replica uses the same roll numbers, starting at `base`'s
+     *                 counter, so the spread comes from the spectrum rather than
+     *                 from the rolls. `base` isn't advanced
+     *
+     * \throws std::runtime_error if there are less than two replicas or a
+     *         replica has no counts left
+     */
+    BootstrapResult ratios(const SimulationContext& base, std::size_t replicas, Real border, std::size_t rolls = 0) const {
+        if (replicas < 2) throw std::runtime_error("SpectrumBootstrap expects at least two replicas for a spread");
+
+        BootstrapResult ret{ std::vector<Real>(replicas) };
+
+        const auto first = base.getCounter();
+        std::atomic<bool> empty{ false };
+
+        // One replica per task, a replica is much larger than the scheduling cost
+        detail::parallelFor(
+            replicas, replicas,
+            [&] (std::size_t, std::size_t start, std::size_t end) {
+                for (auto i = start; i < end; ++i) {
+                    const auto replicaCounts = replica(i);
+                    if (std::all_of(replicaCounts.begin(), replicaCounts.end(), [] (Real c) { return c == 0; })) {
+                        empty.store(true);
+                        continue;
+                    }
+
+                    const auto ctx = base.withAmplitudes(Distribution(E, replicaCounts));
+
+                    if (rolls == 0) {
+                        ret.ratios[i] = static_cast<Real>(ctx.analyticRatio(border));
+                        continue;
+                    }
+
+                    BorderCounts c;
+                    for (std::size_t r = 0; r < rolls; ++r) {
+                        const auto integral = ctx.roll(first + r).integral;
+                        c.left += (integral < border);
+                        c.right += (integral >= border);
+                    }
+                    ret.ratios[i] = c.ratio();
+                }
+            }
+        );
+
+        if (empty.load()) {
+            throw std::runtime_error("SpectrumBootstrap replica has no counts, the spectrum is too sparse");
+        }
+
+        return ret;
+    } // <-- ratios()
+}; // <-- class SpectrumBootstrap
+
+} // <-- namespace edu28
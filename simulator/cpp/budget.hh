@@ -0,0 +1,110 @@
+#pragma once
+
+// Standard library
+#include <atomic>
+#include <cstdint>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#if __has_include(<unistd.h>)
+#include <unistd.h>
+#endif
+
+#include "base.hh"
+
+namespace edu28 {
+
+/// \brief Implementation detail namespace
+namespace detail {
+
+    /// \brief `bytes` in MiB with one decimal
+    std::string formatMiB(std::uint64_t bytes) {
+        std::ostringstream ss;
+        ss << std::fixed << std::setprecision(1) << static_cast<double>(bytes) / (1 << 20) << " MiB";
+        return ss.str();
+    } // <-- formatMiB()
+
+} // <-- namespace detail
+
+/**
+ * \brief Thrown before a call allocates more than the memory budget allows
+ */
+class MemoryBudgetExceeded : public std::runtime_error {
+    std::uint64_t requestedBytes;
+    std::uint64_t budgetBytes;
+
+public:
+    MemoryBudgetExceeded(const std::string& what, std::uint64_t requested, std::uint64_t budget)
+        : std::runtime_error(
+            what + " needs " + detail::formatMiB(requested) + ", "
+            "over the memory budget of " + detail::formatMiB(budget) + ". "
+            "Use fewer rolls, a histogram, or raise the budget with setMemoryBudget()"
+          ),
+          requestedBytes(requested), budgetBytes(budget)
+    {}
+
+    /// \brief Bytes the call would have allocated
+    std::uint64_t requested() const { return requestedBytes; }
+    /// \brief Budget at the time of the call
+    std::uint64_t budget() const { return budgetBytes; }
+}; // <-- class MemoryBudgetExceeded
+
+/// \brief Implementation detail namespace
+namespace detail {
+
+    /// \brief Half of the physical memory, or no limit if it can't be determined
+    std::uint64_t defaultMemoryBudget() {
+#if defined(_SC_PHYS_PAGES) && defined(_SC_PAGE_SIZE)
+        const auto pages = sysconf(_SC_PHYS_PAGES);
+        const auto pageSize = sysconf(_SC_PAGE_SIZE);
+        if (pages > 0 && pageSize > 0) {
+            return static_cast<std::uint64_t>(pages) * static_cast<std::uint64_t>(pageSize) / 2;
+        }
+#endif
+        return 0;
+    } // <-- defaultMemoryBudget()
+
+    inline std::atomic<std::uint64_t> memoryBudget{ defaultMemoryBudget() };
+
+} // <-- namespace detail
+
+/**
+ * \brief Set the largest result a single call may allocate, in bytes
+ *
+ * Zero disables the check. Defaults to half of the physical memory
+ */
+void setMemoryBudget(std::uint64_t bytes) { detail::memoryBudget.store(bytes); }
+
+/// \brief Largest result a single call may allocate, in bytes. Zero if unlimited
+std::uint64_t getMemoryBudget() { return detail::memoryBudget.load(); }
+
+/// \brief Whether `bytes` fit into the memory budget
+bool fitsMemoryBudget(std::uint64_t bytes) {
+    const auto budget = getMemoryBudget();
+    return budget == 0 || bytes <= budget;
+} // <-- fitsMemoryBudget()
+
+/// \brief Implementation detail namespace
+namespace detail {
+
+    /**
+     * \brief Fail fast if `what` would allocate more than the memory budget
+     *
+     * \throws MemoryBudgetExceeded
+     */
+    void checkMemoryBudget(std::uint64_t bytes, const std::string& what) {
+        if (!fitsMemoryBudget(bytes)) throw MemoryBudgetExceeded(what, bytes, getMemoryBudget());
+    } // <-- checkMemoryBudget()
+
+    /// \brief Size of `count` values of type `T`, saturating instead of overflowing
+    template <typename T>
+    std::uint64_t bytesFor(std::uint64_t count) {
+        constexpr auto limit = UINT64_MAX / sizeof(T);
+        return (count > limit) ? UINT64_MAX : count * sizeof(T);
+    } // <-- bytesFor()
+
+} // <-- namespace detail
+
+} // <-- namespace edu28
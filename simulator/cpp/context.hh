@@ -0,0 +1,778 @@
+#pragma once
+
+// Standard library
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "backend.hh"
+#include "base.hh"
+#include "budget.hh"
+#include "hist.hh"
+#include "metrics.hh"
+#include "prob.hh"
+#include "rng.hh"
+#include "serial.hh"
+#include "signals.hh"
+#include "sketch.hh"
+
+namespace edu28 {
+
+/**
+ * \brief Number of rolls that ended up on either side of a border
+ */
+struct BorderCounts {
+    /// \brief Rolls with integral below the border
+    std::uint64_t left = 0;
+    /// \brief Rolls with integral at or above the border
+    std::uint64_t right = 0;
+
+    BorderCounts& operator+=(const BorderCounts& other) {
+        left += other.left;
+        right += other.right;
+        return *this;
+    } // <-- operator+=()
+
+    /// \brief Pile-up ratio `2 * (left + right) / right`
+    Real ratio() const {
+        return static_cast<Real>(2 * (left + right)) / static_cast<Real>(right);
+    } // <-- ratio()
+}; // <-- struct BorderCounts
+
+/**
+ * \brief Derivatives of the tail fraction and pile-up ratio from a single run
+ *
+ * The tail fraction is `T = P(integral >= border)` and the ratio is `2 / T`.
+ * The border indicator is smoothed with an Epanechnikov kernel `K_h`, so
+ * `dT/dθ = E[K_h(integral - border) * d integral/dθ]` for every parameter
+ * `θ` from the same rolls (common random numbers).
+ */
+struct Sensitivities {
+    /// \brief Parameter to differentiate by
+    enum class Parameter {
+        /// \brief Ratio border
+        Border,
+        /// \brief Common amplitude scale, at 1
+        Scale,
+        /// \brief Left integration border, per grid unit
+        Left,
+        /// \brief Right integration border, per grid unit
+        Right
+    }; // <-- enum class Parameter
+
+    static constexpr std::size_t parameters = 4;
+
+    /// \brief Border the tail is taken at
+    Real border = 0;
+    /// \brief Kernel half-width
+    double bandwidth = 0;
+
+    /// \brief Rolls performed
+    std::uint64_t rolls = 0;
+    /// \brief Rolls with integral at or above the border
+    std::uint64_t right = 0;
+
+    /// \brief Sums of per-roll derivative estimates and of their squares, by parameter
+    std::array<double, parameters> sum{};
+    std::array<double, parameters> sumSq{};
+
+    Sensitivities() = default;
+    Sensitivities(Real border, double bandwidth) : border(border), bandwidth(bandwidth) {}
+
+    /// \brief Epanechnikov kernel `K_h(x)`
+    static double kernel(double x, double h) {
+        const auto u = x / h;
+        return (std::abs(u) < 1) ? 0.75 * (1 - u * u) / h : 0;
+    } // <-- kernel()
+
+    /**
+     * \brief Add a roll with `integral` and window derivatives `dLeft`, `dRight`
+     */
+    void fill(Real integral, Real dLeft, Real dRight) {
+        ++rolls;
+        right += (integral >= border);
+
+        const auto k = kernel(integral - border, bandwidth);
+        if (k == 0) return;
+
+        const std::array<double, parameters> d{ -k, k * integral, k * dLeft, k * dRight };
+        for (std::size_t p = 0; p < parameters; ++p) {
+            sum[p] += d[p];
+            sumSq[p] += d[p] * d[p];
+        }
+    } // <-- fill()
+
+    Sensitivities& operator+=(const Sensitivities& other) {
+        rolls += other.rolls;
+        right += other.right;
+        for (std::size_t p = 0; p < parameters; ++p) {
+            sum[p] += other.sum[p];
+            sumSq[p] += other.sumSq[p];
+        }
+        return *this;
+    } // <-- operator+=()
+
+    /// \brief Fraction of rolls at or above the border
+    double tailFraction() const { return static_cast<double>(right) / static_cast<double>(rolls); }
+    /// \brief Pile-up ratio, same as \ref BorderCounts::ratio()
+    double ratio() const { return 2 / tailFraction(); }
+
+    /// \brief `dT/dθ`
+    double dTail(Parameter p) const {
+        return sum[static_cast<std::size_t>(p)] / static_cast<double>(rolls);
+    } // <-- dTail()
+
+    /// \brief Standard error of \ref dTail()
+    double dTailError(Parameter p) const {
+        const auto n = static_cast<double>(rolls);
+        const auto mean = dTail(p);
+        const auto var = sumSq[static_cast<std::size_t>(p)] / n - mean * mean;
+        return std::sqrt(std::max(var, 0.0) / n);
+    } // <-- dTailError()
+
+    /// \brief `dR/dθ = -2 / T^2 * dT/dθ`
+    double dRatio(Parameter p) const {
+        const auto t = tailFraction();
+        return -2 / (t * t) * dTail(p);
+    } // <-- dRatio()
+
+    /// \brief Standard error of \ref dRatio(), ignoring the error of `T`
+    double dRatioError(Parameter p) const {
+        const auto t = tailFraction();
+        return 2 / (t * t) * dTailError(p);
+    } // <-- dRatioError()
+}; // <-- struct Sensitivities
+
+/**
+ * \brief Double overlap simulation with everything precomputed
+ *
+ * Binds the amplitude distribution, signal shape, integration window and
+ * offset distribution once. Since the composed signal is linear in amplitudes,
+ * its window integral is `amp1 * singleCoef + amp2 * offsetCoef[offset]`,
+ * and both coefficients are taken from shape prefix sums at construction.
+ *
+ * Roll number `i` draws from \ref CounterRng `(seed, i)`. Every call
+ * reserves a fresh range of roll numbers, so results don't depend on the
+ * parallel backend or thread count, and one context may be used from
+ * several threads at once.
+ *
+ * \warning Copies, pickles and \ref save() keep the RNG position. Every copy
+ *          sent to a worker process therefore replays the same roll numbers,
+ *          and their results are the same rolls rather than independent
+ *          samples. Hand each worker a \ref fork() (or run disjoint
+ *          \ref shardRange() ranges with \ref runRange()) instead.
+ */
+class SimulationContext {
+    MixtureDistribution amplitudes;
+
+    Real intLeft = 0;
+    Real intRight = 0;
+    OffsetDistribution offsets;
+    int offsetMin = 0;
+    int offsetMax = 0;
+
+    std::vector<Real> prefix;
+    Real singleCoef = 0;
+    std::vector<Real> offsetCoef;
+
+    // Same for the window widened by one unit on the left or the right
+    Real singleCoefLeft = 0;
+    std::vector<Real> offsetCoefLeft;
+    Real singleCoefRight = 0;
+    std::vector<Real> offsetCoefRight;
+
+    std::uint64_t seed = 0;
+    std::atomic<std::uint64_t> counter{ 0 };
+
+    SimulationContext() = default;
+
+    /**
+     * \brief Window integrals per unit amplitude from \ref prefix
+     *
+     * \return first signal coefficient and second signal coefficients by offset
+     *
+     * \throws std::runtime_error if the grid doesn't contain every offset
+     */
+    std::pair<Real, std::vector<Real>> windowCoefs(const std::vector<Real>& X, Real left, Real right) const {
+        // Same window as integrateSignalRelative()
+        const auto lo = static_cast<std::size_t>(
+            std::lower_bound(X.begin(), X.end(), 9 - left) - X.begin()
+        );
+        const auto hi = static_cast<std::size_t>(
+            std::upper_bound(X.begin(), X.end(), 9 + right) - X.begin()
+        );
+
+        const Real single = (hi > lo) ? prefix[hi] - prefix[lo] : 0;
+
+        std::vector<Real> byOffset(offsetMax - offsetMin + 1);
+        for (int offset = offsetMin; offset <= offsetMax; ++offset) {
+            // Same offset lookup as composeSignals()
+            const auto it = std::find_if(
+                X.begin(), X.end(),
+                [&X, offset] (Real x) { return x - X.front() == offset; }
+            );
+            if (it == X.end()) {
+                throw std::runtime_error("SimulationContext expects every offset to be in the signal's grid");
+            }
+            const auto iOffset = static_cast<std::size_t>(it - X.begin());
+
+            // Second signal sample `j` lands on `j + iOffset`
+            const auto from = std::max(lo, iOffset);
+            byOffset[offset - offsetMin] = (hi > from) ? prefix[hi - iOffset] - prefix[from - iOffset] : 0;
+        }
+
+        return { single, std::move(byOffset) };
+    } // <-- windowCoefs()
+
+    /// \brief Midpoints per amplitude grid interval, see \ref offsetTailProbabilities()
+    static constexpr std::size_t quadratureSteps = 32;
+
+    /// \brief Rolls per independently sketched block, see \ref sketches()
+    static constexpr std::size_t sketchBlockSize = 1 << 16;
+
+    /**
+     * \brief Reserve roll numbers [first, first + n)
+     *
+     * Only unique within this object: copies continue from the same
+     * position, see \ref fork()
+     */
+    std::uint64_t reserve(std::size_t n) { return counter.fetch_add(n); }
+
+    /**
+     * \brief Accumulate `n` rolls into per-chunk copies of `empty` and merge them
+     *
+     * \param fill - `fill(accumulator, roll)`
+     */
+    template <typename Accumulator, typename Fill>
+    Accumulator accumulate(std::size_t n, const Accumulator& empty, Fill fill) {
+        const auto first = reserve(n);
+        const auto chunks = getConcurrency();
+
+        std::vector<Accumulator> partial(chunks, empty);
+        detail::parallelFor(
+            n, chunks,
+            [this, first, &partial, &fill] (std::size_t chunk, std::size_t start, std::size_t end) {
+                auto& acc = partial[chunk];
+                for (std::size_t i = start; i < end; ++i) fill(acc, roll(first + i));
+            }
+        );
+
+        Accumulator ret = empty;
+        for (const auto& p : partial) ret += p;
+        return ret;
+    } // <-- accumulate()
+
+public:
+    /// \brief Add a roll to quantile sketches
+    static void fillSketches(RollSketches& s, const DoubleOverlapRollResult& r) {
+        s.integral.fill(r.integral);
+        s.amplitude.fill(r.amp1);
+        s.amplitude.fill(r.amp2);
+    } // <-- fillSketches()
+
+    /**
+     * \brief Precompute the simulation tables
+     *
+     * \param amplitudes - amplitude distribution (or a mixture of them)
+     * \param signal     - signal shape. `X` must be sorted
+     * \param intLeft    - left integration border (offset relative to 9)
+     * \param intRight   - right integration border (offset relative to 9)
+     * \param offsets    - second signal peak offset distribution
+     * \param seed       - RNG seed
+     *
+     * \throws std::runtime_error if the shape grid isn't sorted or doesn't contain
+     *         every offset
+     */
+    SimulationContext(
+        MixtureDistribution amplitudes,
+        const Signal& signal,
+        Real intLeft, Real intRight,
+        OffsetDistribution offsets,
+        std::uint64_t seed = randomSeed()
+    ) : amplitudes(std::move(amplitudes)),
+        intLeft(intLeft), intRight(intRight),
+        offsets(std::move(offsets)),
+        offsetMin(this->offsets.min()), offsetMax(this->offsets.max()),
+        seed(seed)
+    {
+        const auto& [ X, Y ] = signal;
+
+        if (X.empty() || X.size() != Y.size() || !std::is_sorted(X.begin(), X.end())) {
+            throw std::runtime_error("SimulationContext expects a non-empty signal with a sorted grid");
+        }
+
+        const auto n = X.size();
+
+        prefix.resize(n + 1, 0);
+        for (std::size_t i = 0; i < n; ++i) prefix[i + 1] = prefix[i] + Y[i];
+
+        std::tie(singleCoef, offsetCoef) = windowCoefs(X, intLeft, intRight);
+        std::tie(singleCoefLeft, offsetCoefLeft) = windowCoefs(X, intLeft + 1, intRight);
+        std::tie(singleCoefRight, offsetCoefRight) = windowCoefs(X, intLeft, intRight + 1);
+    } // <-- SimulationContext()
+
+    /**
+     * \brief Precompute the simulation tables for uniform offsets in [offsetMin, offsetMax]
+     *
+     * \throws std::runtime_error if `offsetMax < offsetMin`
+     */
+    SimulationContext(
+        MixtureDistribution amplitudes,
+        const Signal& signal,
+        Real intLeft, Real intRight,
+        int offsetMin = 0, int offsetMax = 42,
+        std::uint64_t seed = randomSeed()
+    ) : SimulationContext(
+            std::move(amplitudes), signal, intLeft, intRight,
+            OffsetDistribution::uniformRange(offsetMin, offsetMax), seed
+        )
+    {}
+
+    /**
+     * \brief Precompute the simulation tables for a single amplitude distribution `E`, `P`
+     */
+    SimulationContext(
+        std::vector<Real> E, const std::vector<Real>& P,
+        const Signal& signal,
+        Real intLeft, Real intRight,
+        int offsetMin = 0, int offsetMax = 42,
+        std::uint64_t seed = randomSeed()
+    ) : SimulationContext(
+            Distribution(std::move(E), P),
+            signal, intLeft, intRight, offsetMin, offsetMax, seed
+        )
+    {}
+
+    SimulationContext(const SimulationContext& other)
+        : amplitudes(other.amplitudes),
+          intLeft(other.intLeft), intRight(other.intRight),
+          offsets(other.offsets), offsetMin(other.offsetMin), offsetMax(other.offsetMax),
+          prefix(other.prefix), singleCoef(other.singleCoef), offsetCoef(other.offsetCoef),
+          singleCoefLeft(other.singleCoefLeft), offsetCoefLeft(other.offsetCoefLeft),
+          singleCoefRight(other.singleCoefRight), offsetCoefRight(other.offsetCoefRight),
+          seed(other.seed), counter(other.counter.load())
+    {}
+
+    /**
+     * \brief Same tables, seed and RNG position with a different amplitude distribution
+     *
+     * Doesn't touch the shape, so it's cheap enough to call per bootstrap replica
+     */
+    SimulationContext withAmplitudes(MixtureDistribution other) const {
+        SimulationContext ret(*this);
+        ret.amplitudes = std::move(other);
+        return ret;
+    } // <-- withAmplitudes()
+
+    /**
+     * \brief Copy that owns the next `n` roll numbers of this context
+     *
+     * This context skips past them, so forks for several workers and the
+     * context itself never roll the same numbers. The fork should do at
+     * most `n` rolls; past them it continues into the range of the next fork
+     */
+    SimulationContext fork(std::uint64_t n) {
+        SimulationContext ret(*this);
+        ret.counter.store(reserve(n));
+        return ret;
+    } // <-- fork()
+
+    /// \brief RNG seed
+    std::uint64_t getSeed() const { return seed; }
+    /// \brief Number of the next roll
+    std::uint64_t getCounter() const { return counter.load(); }
+
+    /// \brief Amplitude distribution
+    const MixtureDistribution& getAmplitudes() const { return amplitudes; }
+    /// \brief Second signal peak offset distribution
+    const OffsetDistribution& getOffsets() const { return offsets; }
+    /// \brief Minimum signal peak offset value
+    int getOffsetMin() const { return offsetMin; }
+    /// \brief Maximum signal peak offset value
+    int getOffsetMax() const { return offsetMax; }
+
+    /// \brief Window integral of the first signal per unit amplitude
+    Real getSingleCoef() const { return singleCoef; }
+    /// \brief Window integral of the second signal per unit amplitude, by offset
+    const std::vector<Real>& getOffsetCoef() const { return offsetCoef; }
+
+    /**
+     * \brief Fingerprint of everything that determines the rolls
+     *
+     * Hashes the serialized distributions, tables and seed, but not the RNG
+     * position, so every shard of a run has the same one
+     */
+    std::uint64_t setupHash() const {
+        BinaryWriter w;
+        saveSetup(w);
+        return detail::hashBytes(w.str());
+    } // <-- setupHash()
+
+    /**
+     * \brief Store the precomputed tables and RNG position
+     */
+    void save(BinaryWriter& w) const {
+        saveSetup(w);
+        w.write(counter.load());
+    } // <-- save()
+
+private:
+    /// \brief Store everything \ref save() does but the RNG position
+    void saveSetup(BinaryWriter& w) const {
+        amplitudes.save(w);
+        w.write(intLeft);
+        w.write(intRight);
+        offsets.save(w);
+        w.write(prefix);
+        w.write(singleCoef);
+        w.write(offsetCoef);
+        w.write(singleCoefLeft);
+        w.write(offsetCoefLeft);
+        w.write(singleCoefRight);
+        w.write(offsetCoefRight);
+        w.write(seed);
+    } // <-- saveSetup()
+
+public:
+    static SimulationContext load(BinaryReader& r) {
+        SimulationContext ret;
+        ret.amplitudes = MixtureDistribution::load(r);
+        ret.intLeft = r.read<Real>();
+        ret.intRight = r.read<Real>();
+        ret.offsets = OffsetDistribution::load(r);
+        ret.offsetMin = ret.offsets.min();
+        ret.offsetMax = ret.offsets.max();
+        ret.prefix = r.readVector<Real>();
+        ret.singleCoef = r.read<Real>();
+        ret.offsetCoef = r.readVector<Real>();
+        ret.singleCoefLeft = r.read<Real>();
+        ret.offsetCoefLeft = r.readVector<Real>();
+        ret.singleCoefRight = r.read<Real>();
+        ret.offsetCoefRight = r.readVector<Real>();
+        ret.seed = r.read<std::uint64_t>();
+        ret.counter.store(r.read<std::uint64_t>());
+
+        const auto offsets = static_cast<std::size_t>(ret.offsetMax - ret.offsetMin + 1);
+        if (
+            ret.offsetMax < ret.offsetMin || ret.offsetCoef.size() != offsets
+            || ret.offsetCoefLeft.size() != offsets || ret.offsetCoefRight.size() != offsets
+        ) {
+            throw std::runtime_error("Corrupted serialized SimulationContext");
+        }
+        return ret;
+    } // <-- load()
+
+    /**
+     * \brief Perform roll number `index`
+     */
+    DoubleOverlapRollResult roll(std::uint64_t index) const {
+        CounterRng rng(seed, index);
+
+        const int offset = offsets(rng);
+        const Real amp1 = amplitudes(rng);
+        const Real amp2 = amplitudes(rng);
+
+        return DoubleOverlapRollResult{
+            offset, amp1, amp2,
+            amp1 * singleCoef + amp2 * offsetCoef[offset - offsetMin]
+        };
+    } // <-- roll()
+
+    /**
+     * \brief Smallest and largest integral a roll can produce
+     */
+    std::pair<Real, Real> integralRange() const {
+        // Only offsets that can occur
+        Real bMin = std::numeric_limits<Real>::max();
+        Real bMax = std::numeric_limits<Real>::lowest();
+        for (std::size_t o = 0; o < offsetCoef.size(); ++o) {
+            if (offsets.probabilities()[o] <= 0) continue;
+            bMin = std::min(bMin, offsetCoef[o]);
+            bMax = std::max(bMax, offsetCoef[o]);
+        }
+
+        Real lo = std::numeric_limits<Real>::max();
+        Real hi = std::numeric_limits<Real>::lowest();
+        for (const auto a1 : { amplitudes.min(), amplitudes.max() }) {
+            for (const auto a2 : { amplitudes.min(), amplitudes.max() }) {
+                for (const auto b : { bMin, bMax }) {
+                    lo = std::min(lo, a1 * singleCoef + a2 * b);
+                    hi = std::max(hi, a1 * singleCoef + a2 * b);
+                }
+            }
+        }
+
+        return { lo, hi };
+    } // <-- integralRange()
+
+    /**
+     * \brief Probability of an integral at or above `border` for every offset,
+     *        without rolling
+     *
+     * For offset `o` it's `P(amp1 * singleCoef + amp2 * offsetCoef[o] >= border)`.
+     * The outer integral over `amp1` takes \ref quadratureSteps midpoints per
+     * amplitude grid interval, the inner one is the exact amplitude CDF.
+     */
+    std::vector<double> offsetTailProbabilities(Real border) const {
+        const auto& components = amplitudes.getComponents();
+        const auto& weights = amplitudes.getWeights();
+
+        double totalWeight = 0;
+        for (auto w : weights) totalWeight += w;
+
+        std::vector<double> ret(offsetCoef.size(), 0);
+        for (std::size_t o = 0; o < offsetCoef.size(); ++o) {
+            const auto c = offsetCoef[o];
+
+            // Tail probability given the first amplitude
+            const auto given = [this, c, border] (Real amp1) -> double {
+                const auto rest = border - amp1 * singleCoef;
+                if (c > 0) return 1 - amplitudes.cdfAt(rest / c);
+                return rest <= 0;
+            };
+
+            for (std::size_t k = 0; k < components.size(); ++k) {
+                const auto& E = components[k].grid();
+                const auto& cdf = components[k].cdfTable();
+                const auto w = weights[k] / totalWeight;
+
+                for (std::size_t i = 0; i + 1 < E.size(); ++i) {
+                    const auto mass = cdf[i + 1] - cdf[i];
+                    if (mass <= 0) continue;
+
+                    double sum = 0;
+                    for (std::size_t j = 0; j < quadratureSteps; ++j) {
+                        const auto t = (static_cast<Real>(j) + Real{ 0.5 }) / quadratureSteps;
+                        sum += given(E[i] + t * (E[i + 1] - E[i]));
+                    }
+                    ret[o] += w * mass * sum / quadratureSteps;
+                }
+            }
+        }
+
+        return ret;
+    } // <-- offsetTailProbabilities()
+
+    /**
+     * \brief Probability of an integral at or above `border`, without rolling
+     *
+     * \ref offsetTailProbabilities() weighted by the offset distribution
+     */
+    double tailFraction(Real border) const {
+        const auto byOffset = offsetTailProbabilities(border);
+        const auto& pmf = offsets.probabilities();
+
+        double ret = 0;
+        for (std::size_t o = 0; o < byOffset.size(); ++o) ret += pmf[o] * byOffset[o];
+        return ret;
+    } // <-- tailFraction()
+
+    /**
+     * \brief Pile-up ratio for `border` from \ref tailFraction(), without rolling
+     */
+    double analyticRatio(Real border) const {
+        return 2 / tailFraction(border);
+    } // <-- analyticRatio()
+
+    /**
+     * \brief Perform `n` rolls and return all results
+     *
+     * \throws MemoryBudgetExceeded if the results don't fit into the memory budget.
+     *         No roll numbers are used up then
+     */
+    BulkResult<DoubleOverlapRollResult> run(std::size_t n) {
+        detail::checkMemoryBudget(
+            detail::bytesFor<DoubleOverlapRollResult>(n),
+            "SimulationContext::run() of " + std::to_string(n) + " rolls"
+        );
+
+        const auto first = reserve(n);
+
+        BulkResult<DoubleOverlapRollResult> ret(n);
+        ret.metrics = detail::meteredParallelFor(
+            n,
+            [this, first, &ret] (std::size_t, std::size_t start, std::size_t end) {
+                for (std::size_t i = start; i < end; ++i) ret[i] = roll(first + i);
+            }
+        );
+        ret.metrics.peakBytes = ret.capacity() * sizeof(DoubleOverlapRollResult);
+
+        return ret;
+    } // <-- run()
+
+    /**
+     * \brief Perform `n` rolls and histogram the integrals over [lo, hi]
+     */
+    Histogram histogram(std::size_t n, std::size_t bins, Real lo, Real hi) {
+        return histogram(n, Binning::uniform(bins, lo, hi));
+    } // <-- histogram()
+
+    /**
+     * \brief Perform `n` rolls and histogram the integrals with `binning`
+     */
+    Histogram histogram(std::size_t n, const Binning& binning) {
+        return accumulate(
+            n, Histogram(binning),
+            [] (Histogram& h, const DoubleOverlapRollResult& r) { h.fill(r.integral); }
+        );
+    } // <-- histogram()
+
+    /**
+     * \brief Perform `n` rolls and histogram the integrals over \ref integralRange()
+     */
+    Histogram histogram(std::size_t n, std::size_t bins) {
+        const auto [ lo, hi ] = integralRange();
+        return histogram(n, bins, lo, hi);
+    } // <-- histogram()
+
+    /**
+     * \brief Perform `n` rolls and histogram the integrals over [lo, hi],
+     *        storing only occupied bins
+     */
+    SparseHistogram sparseHistogram(std::size_t n, std::uint64_t bins, Real lo, Real hi) {
+        return sparseHistogram(n, Binning::uniform(bins, lo, hi));
+    } // <-- sparseHistogram()
+
+    /**
+     * \brief Perform `n` rolls and histogram the integrals with `binning`,
+     *        storing only occupied bins
+     */
+    SparseHistogram sparseHistogram(std::size_t n, const Binning& binning) {
+        auto ret = accumulate(
+            n, SparseHistogram(binning),
+            [] (SparseHistogram& h, const DoubleOverlapRollResult& r) { h.fill(r.integral); }
+        );
+        ret.compact();
+        return ret;
+    } // <-- sparseHistogram()
+
+    /**
+     * \brief Perform `n` rolls and histogram the integrals with bounded relative error
+     *
+     * See \ref HdrHistogram
+     */
+    HdrHistogram hdrHistogram(std::size_t n, double lowest, double highest, double relativeError) {
+        return accumulate(
+            n, HdrHistogram(lowest, highest, relativeError),
+            [] (HdrHistogram& h, const DoubleOverlapRollResult& r) { h.fill(r.integral); }
+        );
+    } // <-- hdrHistogram()
+
+    /**
+     * \brief Perform `n` rolls and sketch the integral and amplitude quantiles
+     *
+     * Rolls are sketched in blocks of \ref sketchBlockSize merged in order,
+     * so the result doesn't depend on the backend or thread count
+     *
+     * \param k - sketch section size, see \ref QuantileSketch
+     */
+    RollSketches sketches(std::size_t n, std::uint32_t k = QuantileSketch::defaultK) {
+        const auto first = reserve(n);
+
+        RollSketches ret(k, mix64(~seed ^ first));
+        detail::orderedBlocks(
+            (n + sketchBlockSize - 1) / sketchBlockSize, ret,
+            [this, first, n, k] (RollSketches& acc, std::size_t, std::size_t block) {
+                const auto from = block * sketchBlockSize;
+                const auto to = std::min<std::size_t>(from + sketchBlockSize, n);
+
+                acc = RollSketches(k, mix64(seed ^ (first + from)));
+                for (auto i = from; i < to; ++i) fillSketches(acc, roll(first + i));
+            },
+            [&ret] (const RollSketches& acc) { ret += acc; }
+        );
+
+        return ret;
+    } // <-- sketches()
+
+    /**
+     * \brief Perform `n` rolls and count integrals on either side of `border`
+     */
+    BorderCounts borderCounts(std::size_t n, Real border) {
+        return accumulate(
+            n, BorderCounts{},
+            [border] (BorderCounts& c, const DoubleOverlapRollResult& r) {
+                c.left += (r.integral < border);
+                c.right += (r.integral >= border);
+            }
+        );
+    } // <-- borderCounts()
+
+    /**
+     * \brief Perform `n` rolls and differentiate the tail fraction and ratio
+     *        at `border`, see \ref Sensitivities
+     *
+     * Window derivatives are the integral change from widening the window
+     * by one grid unit, which is exact for a sampled shape. Blocks of
+     * \ref sketchBlockSize rolls are merged in order, so the result doesn't
+     * depend on the backend or thread count.
+     *
+     * \param bandwidth - kernel half-width. If not positive, `2.34 * sigma * n^(-1/5)`
+     *                    with `sigma` of the integrals estimated from the first rolls
+     *
+     * \throws std::runtime_error if the bandwidth can't be estimated
+     */
+    Sensitivities sensitivities(std::size_t n, Real border, double bandwidth = 0) {
+        const auto first = reserve(n);
+
+        if (bandwidth <= 0) {
+            // Pilot rolls are repeated by the main pass, so they cost nothing in accuracy
+            const auto pilot = std::min<std::size_t>(n, 4096);
+            double mean = 0, m2 = 0;
+            for (std::size_t i = 0; i < pilot; ++i) {
+                const auto x = static_cast<double>(roll(first + i).integral);
+                const auto delta = x - mean;
+                mean += delta / static_cast<double>(i + 1);
+                m2 += delta * (x - mean);
+            }
+
+            const auto sigma = (pilot > 1) ? std::sqrt(m2 / static_cast<double>(pilot - 1)) : 0.0;
+            bandwidth = 2.34 * sigma * std::pow(static_cast<double>(n), -0.2);
+            if (!(bandwidth > 0)) {
+                throw std::runtime_error("Can't estimate the sensitivity bandwidth, pass it explicitly");
+            }
+        }
+
+        const Sensitivities empty(border, bandwidth);
+        Sensitivities ret = empty;
+        detail::orderedBlocks(
+            (n + sketchBlockSize - 1) / sketchBlockSize, empty,
+            [this, first, n] (Sensitivities& acc, std::size_t, std::size_t block) {
+                const auto from = block * sketchBlockSize;
+                const auto to = std::min<std::size_t>(from + sketchBlockSize, n);
+
+                for (auto i = from; i < to; ++i) {
+                    const auto r = roll(first + i);
+                    const auto o = static_cast<std::size_t>(r.offset - offsetMin);
+                    acc.fill(
+                        r.integral,
+                        r.amp1 * (singleCoefLeft - singleCoef) + r.amp2 * (offsetCoefLeft[o] - offsetCoef[o]),
+                        r.amp1 * (singleCoefRight - singleCoef) + r.amp2 * (offsetCoefRight[o] - offsetCoef[o])
+                    );
+                }
+            },
+            [&ret] (const Sensitivities& acc) { ret += acc; }
+        );
+
+        return ret;
+    } // <-- sensitivities()
+
+    /**
+     * \brief Perform `n` rolls and compute the pile-up ratio for `border`
+     *
+     * See \ref BorderCounts::ratio()
+     */
+    Real ratio(std::size_t n, Real border) {
+        return borderCounts(n, border).ratio();
+    } // <-- ratio()
+}; // <-- class SimulationContext
+
+} // <-- namespace edu28
@@ -0,0 +1,409 @@
+#pragma once
+
+// Standard library
+#include <algorithm>
+#include <concepts>
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base.hh"
+#include "signals.hh"
+
+namespace edu28 {
+
+/**
+ * \brief Lazy signal algebra
+ *
+ * `lazy(S)`, `a * e`, `e1 + e2`, `e1 - e2`, `shift(e, offset)` and
+ * `window(e, from, to)` build a tree of small nodes that only reference the
+ * signals. Values are sampled on the grid of the leftmost signal, the same
+ * way \ref composeSignals() keeps the first signal's grid:
+ * - `shift` moves a subexpression by the number of samples that
+ *   \ref composeSignals() would for the same `offset`;
+ * - `window` zeroes the samples outside of `[from, to]`, bounds included as
+ *   in \ref integrateSignal();
+ * - samples shifted past the grid are dropped.
+ *
+ * \ref evaluate() materializes the result in a single pass without
+ * intermediate signals. \ref integrate() doesn't sample the tree at all: it
+ * pushes the integration range down to the leaves, moving it by shifts and
+ * clipping it by windows, and sums every leaf once over what's left.
+ *
+ * Leaves hold references, so the signals must outlive the expression.
+ */
+template <typename T>
+concept SignalExpression = requires (const T& e, std::ptrdiff_t i, Real c) {
+    { e.grid() } -> std::convertible_to<const std::vector<Real>&>;
+    { e.at(i) } -> std::convertible_to<Real>;
+    { e.integral(c, i, i) } -> std::convertible_to<Real>;
+};
+
+namespace detail {
+
+    /// \brief Samples `offset` shifts by, same lookup as \ref composeSignals()
+    std::ptrdiff_t offsetSamples(const std::vector<Real>& X, Real offset) {
+        for (std::size_t i = 0; i < X.size(); ++i) {
+            if (X[i] - X.front() == offset) return static_cast<std::ptrdiff_t>(i);
+        }
+        throw std::runtime_error("Signal shift expects `offset` to be in the signal's grid");
+    } // <-- offsetSamples()
+
+    /// \brief Samples [begin, end) of `X` inside `[from, to]`, same bounds as \ref integrateSignal()
+    std::pair<std::ptrdiff_t, std::ptrdiff_t> windowSamples(const std::vector<Real>& X, Real from, Real to) {
+        return {
+            std::lower_bound(X.begin(), X.end(), from) - X.begin(),
+            std::upper_bound(X.begin(), X.end(), to) - X.begin()
+        };
+    } // <-- windowSamples()
+
+    /// \brief Throws unless signals of both grids can be added sample by sample
+    void checkAligned(const std::vector<Real>& X1, const std::vector<Real>& X2) {
+        if (X1.size() != X2.size() || (!X1.empty() && X1.front() != X2.front())) {
+            throw std::runtime_error("Signal sum expects aligned signal grids");
+        }
+    } // <-- checkAligned()
+
+} // <-- namespace detail
+
+/// \brief Reference to a signal
+class SignalLeaf {
+    const Signal* signal;
+
+public:
+    explicit SignalLeaf(const Signal& signal) : signal(&signal) {}
+
+    const std::vector<Real>& grid() const { return std::get<0>(*signal); }
+
+    Real at(std::ptrdiff_t i) const {
+        const auto& Y = std::get<1>(*signal);
+        return (i >= 0 && i < static_cast<std::ptrdiff_t>(Y.size())) ? Y[i] : Real{ 0 };
+    } // <-- at()
+
+    /// \brief `coef` times the sum of samples [lo, hi)
+    Real integral(Real coef, std::ptrdiff_t lo, std::ptrdiff_t hi) const {
+        const auto& Y = std::get<1>(*signal);
+        lo = std::max<std::ptrdiff_t>(lo, 0);
+        hi = std::min<std::ptrdiff_t>(hi, static_cast<std::ptrdiff_t>(Y.size()));
+
+        Real ret = 0;
+        for (auto i = lo; i < hi; ++i) ret += Y[i];
+        return coef * ret;
+    } // <-- integral()
+}; // <-- class SignalLeaf
+
+/// \brief Subexpression times a constant
+template <SignalExpression E>
+class ScaledSignal {
+    E inner;
+    Real scale;
+
+public:
+    ScaledSignal(E inner, Real scale) : inner(std::move(inner)), scale(scale) {}
+
+    const std::vector<Real>& grid() const { return inner.grid(); }
+    Real at(std::ptrdiff_t i) const { return scale * inner.at(i); }
+    Real integral(Real coef, std::ptrdiff_t lo, std::ptrdiff_t hi) const { return inner.integral(coef * scale, lo, hi); }
+}; // <-- class ScaledSignal
+
+/// \brief Subexpression delayed by a number of samples
+template <SignalExpression E>
+class ShiftedSignal {
+    E inner;
+    std::ptrdiff_t samples;
+
+public:
+    ShiftedSignal(E inner, std::ptrdiff_t samples) : inner(std::move(inner)), samples(samples) {}
+
+    const std::vector<Real>& grid() const { return inner.grid(); }
+    Real at(std::ptrdiff_t i) const { return inner.at(i - samples); }
+    Real integral(Real coef, std::ptrdiff_t lo, std::ptrdiff_t hi) const { return inner.integral(coef, lo - samples, hi - samples); }
+}; // <-- class ShiftedSignal
+
+/// \brief Sample-wise sum of two subexpressions
+template <SignalExpression E1, SignalExpression E2>
+class SumSignal {
+    E1 first;
+    E2 second;
+
+public:
+    SumSignal(E1 first, E2 second) : first(std::move(first)), second(std::move(second)) {
+        detail::checkAligned(this->first.grid(), this->second.grid());
+    }
+
+    const std::vector<Real>& grid() const { return first.grid(); }
+    Real at(std::ptrdiff_t i) const { return first.at(i) + second.at(i); }
+    Real integral(Real coef, std::ptrdiff_t lo, std::ptrdiff_t hi) const {
+        return first.integral(coef, lo, hi) + second.integral(coef, lo, hi);
+    } // <-- integral()
+}; // <-- class SumSignal
+
+/// \brief Subexpression zeroed outside of samples [begin, end)
+template <SignalExpression E>
+class WindowedSignal {
+    E inner;
+    std::ptrdiff_t begin;
+    std::ptrdiff_t end;
+
+public:
+    WindowedSignal(E inner, std::ptrdiff_t begin, std::ptrdiff_t end) : inner(std::move(inner)), begin(begin), end(end) {}
+
+    const std::vector<Real>& grid() const { return inner.grid(); }
+    Real at(std::ptrdiff_t i) const { return (i >= begin && i < end) ? inner.at(i) : Real{ 0 }; }
+    Real integral(Real coef, std::ptrdiff_t lo, std::ptrdiff_t hi) const {
+        lo = std::max(lo, begin);
+        hi = std::min(hi, end);
+        return (hi > lo) ? inner.integral(coef, lo, hi) : Real{ 0 };
+    } // <-- integral()
+}; // <-- class WindowedSignal
+
+/// \brief Start a lazy expression from a signal
+SignalLeaf lazy(const Signal& signal) { return SignalLeaf(signal); }
+/// \brief A temporary signal would dangle
+SignalLeaf lazy(Signal&&) = delete;
+
+template <SignalExpression E>
+ScaledSignal<E> operator*(Real scale, E e) { return ScaledSignal<E>(std::move(e), scale); }
+
+template <SignalExpression E>
+ScaledSignal<E> operator*(E e, Real scale) { return ScaledSignal<E>(std::move(e), scale); }
+
+template <SignalExpression E>
+ScaledSignal<E> operator-(E e) { return ScaledSignal<E>(std::move(e), -1); }
+
+/// \throws std::runtime_error if the grids aren't aligned
+template <SignalExpression E1, SignalExpression E2>
+SumSignal<E1, E2> operator+(E1 first, E2 second) { return SumSignal<E1, E2>(std::move(first), std::move(second)); }
+
+/// \throws std::runtime_error if the grids aren't aligned
+template <SignalExpression E1, SignalExpression E2>
+SumSignal<E1, ScaledSignal<E2>> operator-(E1 first, E2 second) { return std::move(first) + (-std::move(second)); }
+
+/**
+ * \brief Delay a subexpression by `offset`
+ *
+ * \throws std::runtime_error if `offset` isn't in the expression's grid
+ */
+template <SignalExpression E>
+ShiftedSignal<E> shift(E e, Real offset) {
+    const auto samples = detail::offsetSamples(e.grid(), offset);
+    return ShiftedSignal<E>(std::move(e), samples);
+} // <-- shift()
+
+/// \brief Zero a subexpression outside of `[from, to]`
+template <SignalExpression E>
+WindowedSignal<E> window(E e, Real from, Real to) {
+    const auto [ begin, end ] = detail::windowSamples(e.grid(), from, to);
+    return WindowedSignal<E>(std::move(e), begin, end);
+} // <-- window()
+
+/**
+ * \brief Sample an expression on its grid in one pass
+ */
+template <SignalExpression E>
+Signal evaluate(const E& e) {
+    const auto& X = e.grid();
+    std::vector<Real> Y(X.size());
+    for (std::size_t i = 0; i < X.size(); ++i) Y[i] = e.at(static_cast<std::ptrdiff_t>(i));
+    return { X, std::move(Y) };
+} // <-- evaluate()
+
+/**
+ * \brief Same as `integrateSignal(evaluate(e), intFrom, intTo)` without sampling the tree
+ */
+template <SignalExpression E>
+Real integrate(const E& e, Real intFrom, Real intTo) {
+    const auto [ begin, end ] = detail::windowSamples(e.grid(), intFrom, intTo);
+    return (end > begin) ? e.integral(1, begin, end) : Real{ 0 };
+} // <-- integrate()
+
+/**
+ * \brief Signal expression in linear normal form, built at runtime
+ *
+ * Same algebra as the templates above for when the tree isn't known at
+ * compile time, e.g. from Python. Any expression reduces to a sum of terms
+ * `coef * window(shift(S, samples), begin, end)`, so every operation only
+ * edits the term list and \ref integrate() costs O(1) per term from the
+ * signals' prefix sums. Terms own shared copies of their signals.
+ */
+class SignalExpr {
+    /// \brief Signal with its prefix sums
+    struct Leaf {
+        Signal signal;
+        std::vector<double> prefix;
+
+        explicit Leaf(Signal s) : signal(std::move(s)) {
+            const auto& Y = std::get<1>(signal);
+            prefix.resize(Y.size() + 1, 0);
+            for (std::size_t i = 0; i < Y.size(); ++i) prefix[i + 1] = prefix[i] + Y[i];
+        } // <-- Leaf()
+    }; // <-- struct Leaf
+
+    struct Term {
+        std::shared_ptr<const Leaf> leaf;
+        Real coef;
+        /// \brief Delay of the leaf, in samples
+        std::ptrdiff_t samples;
+        /// \brief Output samples [begin, end) the term is nonzero on
+        std::ptrdiff_t begin;
+        std::ptrdiff_t end;
+    }; // <-- struct Term
+
+    std::vector<Term> terms;
+
+    const std::vector<Real>& X() const { return std::get<0>(terms.front().leaf->signal); }
+
+    /// \brief Output samples [begin, end) a term covers: its window, its shifted leaf and the grid
+    std::pair<std::ptrdiff_t, std::ptrdiff_t> support(const Term& t) const {
+        const auto size = static_cast<std::ptrdiff_t>(std::get<1>(t.leaf->signal).size());
+        return {
+            std::max({ t.begin, t.samples, std::ptrdiff_t{ 0 } }),
+            std::min({ t.end, t.samples + size, static_cast<std::ptrdiff_t>(X().size()) })
+        };
+    } // <-- support()
+
+    SignalExpr() = default;
+
+public:
+    /// \brief A single signal
+    explicit SignalExpr(Signal signal) {
+        auto leaf = std::make_shared<const Leaf>(std::move(signal));
+        const auto size = static_cast<std::ptrdiff_t>(std::get<0>(leaf->signal).size());
+        terms.push_back(Term{ std::move(leaf), 1, 0, 0, size });
+    } // <-- SignalExpr()
+
+    /// \brief Output grid
+    const std::vector<Real>& grid() const { return X(); }
+    /// \brief Number of terms
+    std::size_t size() const { return terms.size(); }
+
+    SignalExpr& operator*=(Real scale) {
+        for (auto& t : terms) t.coef *= scale;
+        return *this;
+    } // <-- operator*=()
+
+    /// \throws std::runtime_error if the grids aren't aligned
+    SignalExpr& operator+=(const SignalExpr& other) {
+        detail::checkAligned(X(), other.X());
+        terms.insert(terms.end(), other.terms.begin(), other.terms.end());
+        return *this;
+    } // <-- operator+=()
+
+    friend SignalExpr operator*(SignalExpr e, Real scale) { return e *= scale; }
+    friend SignalExpr operator*(Real scale, SignalExpr e) { return e *= scale; }
+    friend SignalExpr operator-(SignalExpr e) { return e *= -1; }
+    friend SignalExpr operator+(SignalExpr a, const SignalExpr& b) { return a += b; }
+    friend SignalExpr operator-(SignalExpr a, SignalExpr b) { return a += (b *= -1); }
+
+    /**
+     * \brief Delayed by `offset`, see \ref shift()
+     *
+     * \throws std::runtime_error if `offset` isn't in the grid
+     */
+    SignalExpr shift(Real offset) const {
+        const auto samples = detail::offsetSamples(X(), offset);
+
+        auto ret = *this;
+        for (auto& t : ret.terms) {
+            t.samples += samples;
+            t.begin += samples;
+            t.end += samples;
+        }
+        return ret;
+    } // <-- shift()
+
+    /// \brief Zeroed outside of `[from, to]`, see \ref window()
+    SignalExpr window(Real from, Real to) const {
+        const auto [ begin, end ] = detail::windowSamples(X(), from, to);
+
+        auto ret = *this;
+        for (auto& t : ret.terms) {
+            t.begin = std::max(t.begin, begin);
+            t.end = std::min(t.end, end);
+        }
+        return ret;
+    } // <-- window()
+
+    /**
+     * \brief Merge terms that differ only by coefficients and drop empty ones
+     */
+    SignalExpr simplified() const {
+        SignalExpr ret;
+        for (const auto& t : terms) {
+            const auto [ begin, end ] = support(t);
+            if (end <= begin) continue;
+
+            Term clipped = t;
+            clipped.begin = begin;
+            clipped.end = end;
+
+            const auto same = std::find_if(
+                ret.terms.begin(), ret.terms.end(),
+                [&clipped] (const Term& u) {
+                    return u.leaf == clipped.leaf && u.samples == clipped.samples
+                        && u.begin == clipped.begin && u.end == clipped.end;
+                }
+            );
+            if (same == ret.terms.end()) {
+                ret.terms.push_back(std::move(clipped));
+            } else {
+                same->coef += clipped.coef;
+            }
+        }
+
+        std::erase_if(ret.terms, [] (const Term& t) { return t.coef == 0; });
+
+        // Keep the grid even if every term cancelled
+        if (ret.terms.empty()) {
+            ret.terms.push_back(terms.front());
+            ret.terms.front().coef = 0;
+        }
+        return ret;
+    } // <-- simplified()
+
+    /// \brief Sample the expression on its grid, one pass per term
+    Signal evaluate() const {
+        std::vector<Real> Y(X().size(), 0);
+        for (const auto& t : terms) {
+            const auto& leafY = std::get<1>(t.leaf->signal);
+            const auto [ begin, end ] = support(t);
+            for (auto i = begin; i < end; ++i) Y[i] += t.coef * leafY[i - t.samples];
+        }
+        return { X(), std::move(Y) };
+    } // <-- evaluate()
+
+    /// \brief Same as `integrateSignal(evaluate(), intFrom, intTo)` in O(1) per term
+    Real integrate(Real intFrom, Real intTo) const {
+        const auto [ from, to ] = detail::windowSamples(X(), intFrom, intTo);
+
+        double ret = 0;
+        for (const auto& t : terms) {
+            auto [ begin, end ] = support(t);
+            begin = std::max(begin, from);
+            end = std::min(end, to);
+            if (end > begin) ret += t.coef * (t.leaf->prefix[end - t.samples] - t.leaf->prefix[begin - t.samples]);
+        }
+        return static_cast<Real>(ret);
+    } // <-- integrate()
+
+    /// \brief Human-readable term list, signals numbered by first appearance
+    std::string toString() const {
+        std::vector<const Leaf*> leaves;
+        std::string ret;
+        for (const auto& t : terms) {
+            auto it = std::find(leaves.begin(), leaves.end(), t.leaf.get());
+            if (it == leaves.end()) it = leaves.insert(it, t.leaf.get());
+
+            if (!ret.empty()) ret += " + ";
+            ret += std::to_string(t.coef) + " * S" + std::to_string(it - leaves.begin())
+                + "[shift " + std::to_string(t.samples)
+                + ", samples " + std::to_string(t.begin) + ".." + std::to_string(t.end) + "]";
+        }
+        return ret;
+        } // <-- toString()
+}; // <-- class SignalExpr
+
+} // <-- namespace edu28
@@ -1,11 +1,110 @@
-// PyBind / Torch
-#include <torch/extension.h>
+// PyBind
+#include <pybind11/pybind11.h>
 #include <pybind11/numpy.h>
+#include <pybind11/operators.h>
+#include <pybind11/stl.h>
+#include <pybind11/stl_bind.h>
 
+#include "alloc.hh"
+#include "backend.hh"
+#include "bootstrap.hh"
+#include "budget.hh"
+#include "context.hh"
+#include "expr.hh"
+#include "hist.hh"
+#include "metrics.hh"
 #include "prob.hh"
+#include "response.hh"
+#include "serial.hh"
+#include "shard.hh"
 #include "signals.hh"
+#include "sketch.hh"
+#include "stream.hh"
+#include "table.hh"
+#include "tail.hh"
+#include "unfold.hh"
+
+namespace py = pybind11;
+
+// Set by the torch extension builder
+#ifndef TORCH_EXTENSION_NAME
+#define TORCH_EXTENSION_NAME cpp
+#endif
+
+// Keep roll results in C++ memory instead of converting them to lists
+PYBIND11_MAKE_OPAQUE(edu28::BulkVector<edu28::DoubleOverlapRollResult>)
+
+/**
+ * \brief Pickle support through \ref edu28::serialize()
+ */
+template <typename T>
+auto pickleBinary() {
+    return py::pickle(
+        [] (const T& value) { return py::bytes(edu28::serialize(value)); },
+        [] (const py::bytes& state) { return edu28::deserialize<T>(std::string_view(state)); }
+    );
+} // <-- pickleBinary()
+
+/**
+ * \brief Bind a \ref edu28::RollStream as a Python iterator over result blocks
+ */
+template <typename Result>
+void bindRollStream(py::module_& m, const char* name) {
+    using Stream = edu28::RollStream<Result>;
+
+    py::class_<Stream>(m, name)
+        .def("__iter__", [] (Stream& s) -> Stream& { return s; })
+        .def(
+            "__next__",
+            [] (Stream& s) {
+                auto block = [&s] {
+                    py::gil_scoped_release release;
+                    return s.next();
+                } ();
+                if (!block) throw py::stop_iteration();
+                return std::move(*block);
+            }
+        )
+        .def("cancel", &Stream::cancel, "Stop producing new blocks")
+        .def(
+            "metrics",
+            &Stream::metrics,
+            py::call_guard<py::gil_scoped_release>(),
+            "Producer performance, waits for the producers to finish"
+        )
+    ;
+} // <-- bindRollStream()
 
 PYBIND11_MODULE(TORCH_EXTENSION_NAME, m) {
+    py::enum_<edu28::Backend>(m, "Backend")
+        .value("Threads", edu28::Backend::Threads)
+        .value("OpenMP",  edu28::Backend::OpenMP)
+        .value("StdPar",  edu28::Backend::StdPar)
+    ;
+
+    m.def("setBackend", edu28::setBackend, "Select the parallel backend for bulk functions");
+    m.def("getBackend", edu28::getBackend, "Get the parallel backend for bulk functions");
+    m.def("setConcurrency", edu28::setConcurrency, "Set the number of parallel chunks for bulk functions");
+    m.def("getConcurrency", edu28::getConcurrency, "Get the number of parallel chunks for bulk functions");
+
+    py::register_exception<edu28::MemoryBudgetExceeded>(m, "MemoryBudgetExceeded", PyExc_MemoryError);
+    m.def("setMemoryBudget", edu28::setMemoryBudget, "Set the largest result a call may allocate, in bytes. 0 disables the check");
+    m.def("getMemoryBudget", edu28::getMemoryBudget, "Get the largest result a call may allocate, in bytes. 0 if unlimited");
+    m.def("fitsMemoryBudget", edu28::fitsMemoryBudget, "Whether an allocation of that many bytes fits into the memory budget");
+    m.attr("realDtype") = py::dtype::of<edu28::Real>();
+
+    py::enum_<edu28::HugePages>(m, "HugePages")
+        .value("Off",         edu28::HugePages::Off)
+        .value("Transparent", edu28::HugePages::Transparent)
+        .value("Explicit",    edu28::HugePages::Explicit)
+    ;
+    m.def("setHugePages", edu28::setHugePages, "Select huge page use for newly mapped result buffers");
+    m.def("getHugePages", edu28::getHugePages, "Get huge page use for newly mapped result buffers");
+    m.def("setBufferPoolLimit", edu28::setBufferPoolLimit, "Set how many bytes of released result buffers are kept for reuse");
+    m.def("getBufferPoolLimit", edu28::getBufferPoolLimit, "Get how many bytes of released result buffers are kept for reuse");
+    m.def("getBufferPoolSize",  edu28::getBufferPoolSize,  "Bytes of released result buffers currently kept for reuse");
+    m.def("releaseBufferPool",  edu28::releaseBufferPool,  "Return every kept result buffer to the system");
+
     m.def(
         "composeSignals",
         edu28::composeSignals,
@@ -35,6 +134,41 @@ PYBIND11_MODULE(TORCH_EXTENSION_NAME, m) {
         "Integrate the signal in terms of sum (relative bounds)"
     );
 
+    py::class_<edu28::SignalExpr>(m, "SignalExpr")
+        .def(py::init<edu28::Signal>(), py::arg("signal"), "Lazy expression of a single signal")
+        .def_property_readonly("grid", &edu28::SignalExpr::grid)
+        .def("shift",  &edu28::SignalExpr::shift,  py::arg("offset"), "Delayed by `offset`, as in composeSignals")
+        .def("window", &edu28::SignalExpr::window, py::arg("lo"), py::arg("hi"), "Zeroed outside of [lo, hi]")
+        .def("simplified", &edu28::SignalExpr::simplified, "Merge terms that differ only by coefficients")
+        .def(
+            "evaluate",
+            &edu28::SignalExpr::evaluate,
+            py::call_guard<py::gil_scoped_release>(),
+            "Sample the expression into a signal"
+        )
+        .def(
+            "integrate",
+            &edu28::SignalExpr::integrate,
+            py::arg("intFrom"), py::arg("intTo"),
+            "Same as `integrateSignal(evaluate(), intFrom, intTo)` without sampling"
+        )
+        .def(py::self + py::self)
+        .def(py::self - py::self)
+        .def(py::self * edu28::Real())
+        .def(edu28::Real() * py::self)
+        .def(-py::self)
+        .def(
+            "__radd__",
+            // Lets `sum()` start from 0
+            [] (const edu28::SignalExpr& e, int zero) {
+                if (zero != 0) throw py::type_error("Only 0 can be added to a SignalExpr");
+                return e;
+            }
+        )
+        .def("__len__",  &edu28::SignalExpr::size)
+        .def("__repr__", [] (const edu28::SignalExpr& e) { return "SignalExpr(" + e.toString() + ")"; })
+    ;
+
     m.def(
         "probNormalize",
         edu28::probNormalize,
@@ -42,6 +176,43 @@ PYBIND11_MODULE(TORCH_EXTENSION_NAME, m) {
         "Normalize probability density"
     );
 
+    m.def(
+        "probNormalizeBatch",
+        [] (
+            py::array_t<edu28::Real, py::array::c_style | py::array::forcecast> E,
+            py::array P
+        ) {
+            if (
+                !P.dtype().is(py::dtype::of<edu28::Real>())
+                || !(P.flags() & py::array::c_style)
+                || !P.writeable()
+                || P.ndim() != 2
+            ) {
+                throw py::type_error("probNormalizeBatch expects `P` to be a writeable C-contiguous 2D array of the module's Real type");
+            }
+
+            const auto rows = static_cast<std::size_t>(P.shape(0));
+            const auto cols = static_cast<std::size_t>(P.shape(1));
+
+            const bool sharedE = (E.ndim() == 1);
+            if (
+                (sharedE && static_cast<std::size_t>(E.shape(0)) != cols)
+                || (!sharedE && (E.ndim() != 2 || static_cast<std::size_t>(E.shape(0)) != rows || static_cast<std::size_t>(E.shape(1)) != cols))
+            ) {
+                throw py::value_error("probNormalizeBatch expects `E` to be a row of P's width or to have P's shape");
+            }
+
+            auto* data = static_cast<edu28::Real*>(P.mutable_data());
+            const auto norms = [&] {
+                py::gil_scoped_release release;
+                return edu28::probNormalizeBatch(E.data(), sharedE, data, rows, cols);
+            } ();
+
+            return py::array_t<edu28::Real>(norms.size(), norms.data());
+        },
+        "Normalize every row of a 2D array of probability densities in place, return normalization constants"
+    );
+
     m.def(
         "rollScalar",
         edu28::rollScalar,
@@ -54,14 +225,78 @@ PYBIND11_MODULE(TORCH_EXTENSION_NAME, m) {
         .def_readonly("amp1",     &edu28::DoubleOverlapRollResult::amp1)
         .def_readonly("amp2",     &edu28::DoubleOverlapRollResult::amp2)
         .def_readonly("integral", &edu28::DoubleOverlapRollResult::integral)
+        .def(pickleBinary<edu28::DoubleOverlapRollResult>())
+    ;
+
+    py::bind_vector<edu28::BulkVector<edu28::DoubleOverlapRollResult>>(m, "DoubleOverlapRollResultVector")
+        .def(pickleBinary<edu28::BulkVector<edu28::DoubleOverlapRollResult>>())
+    ;
+
+    py::class_<edu28::RunMetrics>(m, "RunMetrics")
+        .def_readonly("rolls",        &edu28::RunMetrics::rolls)
+        .def_readonly("wallSeconds",  &edu28::RunMetrics::wallSeconds)
+        .def_readonly("busySeconds",  &edu28::RunMetrics::busySeconds)
+        .def_readonly("chunkSeconds", &edu28::RunMetrics::chunkSeconds)
+        .def_readonly("peakBytes",    &edu28::RunMetrics::peakBytes)
+        .def_property_readonly("rollsPerSecond",  &edu28::RunMetrics::rollsPerSecond)
+        .def_property_readonly("meanBusySeconds", &edu28::RunMetrics::meanBusySeconds)
+        .def_property_readonly("imbalance",       &edu28::RunMetrics::imbalance)
+        .def(
+            "asDict",
+            [] (const edu28::RunMetrics& r) {
+                py::dict ret;
+                ret["rolls"] = r.rolls;
+                ret["wallSeconds"] = r.wallSeconds;
+                ret["rollsPerSecond"] = r.rollsPerSecond();
+                ret["busySeconds"] = r.busySeconds;
+                ret["chunkSeconds"] = r.chunkSeconds;
+                ret["imbalance"] = r.imbalance();
+                ret["peakBytes"] = r.peakBytes;
+                return ret;
+            },
+            "Metrics as a plain dictionary, for logging"
+        )
+        .def(pickleBinary<edu28::RunMetrics>())
+    ;
+
+    py::class_<
+        edu28::BulkResult<edu28::DoubleOverlapRollResult>,
+        edu28::BulkVector<edu28::DoubleOverlapRollResult>
+    >(m, "DoubleOverlapRollBulkResult")
+        .def_readonly("metrics", &edu28::BulkResult<edu28::DoubleOverlapRollResult>::metrics)
+        .def(pickleBinary<edu28::BulkResult<edu28::DoubleOverlapRollResult>>())
+    ;
+
+    py::class_<edu28::BulkResult<edu28::Real>>(m, "SingleRollBulkResult", py::buffer_protocol())
+        .def_buffer(
+            [] (edu28::BulkResult<edu28::Real>& r) {
+                return py::buffer_info(r.data(), static_cast<py::ssize_t>(r.size()));
+            }
+        )
+        .def("__len__", [] (const edu28::BulkResult<edu28::Real>& r) { return r.size(); })
+        .def(
+            "__getitem__",
+            [] (const edu28::BulkResult<edu28::Real>& r, std::size_t i) {
+                if (i >= r.size()) throw py::index_error();
+                return r[i];
+            }
+        )
+        .def_readonly("metrics", &edu28::BulkResult<edu28::Real>::metrics)
+        .def(pickleBinary<edu28::BulkResult<edu28::Real>>())
     ;
 
     m.def(
         "rollDoubleOverlap",
-        edu28::rollDoubleOverlap,
+        py::overload_cast<const std::vector<edu28::Real>&, const std::vector<edu28::Real>&, const edu28::Signal&, edu28::Real, edu28::Real, int, int>(edu28::rollDoubleOverlap),
         py::call_guard<py::gil_scoped_release>(),
         "Perform a random double-signal overlap simulation"
     );
+    m.def(
+        "rollDoubleOverlap",
+        py::overload_cast<const std::vector<edu28::Real>&, const std::vector<edu28::Real>&, const edu28::Signal&, edu28::Real, edu28::Real, const edu28::OffsetDistribution&>(edu28::rollDoubleOverlap),
+        py::call_guard<py::gil_scoped_release>(),
+        "Perform a random double-signal overlap simulation with offsets from an OffsetDistribution"
+    );
     m.def( // With default arguments
         "rollDoubleOverlap",
         [] (
@@ -78,10 +313,16 @@ PYBIND11_MODULE(TORCH_EXTENSION_NAME, m) {
 
     m.def(
         "rollDoubleOverlapBulk",
-        edu28::rollDoubleOverlapBulk,
+        py::overload_cast<std::size_t, const std::vector<edu28::Real>&, const std::vector<edu28::Real>&, const edu28::Signal&, edu28::Real, edu28::Real, int, int>(edu28::rollDoubleOverlapBulk),
         py::call_guard<py::gil_scoped_release>(),
         "Perform several random double-signal overlap simulations"
     );
+    m.def(
+        "rollDoubleOverlapBulk",
+        py::overload_cast<std::size_t, const std::vector<edu28::Real>&, const std::vector<edu28::Real>&, const edu28::Signal&, edu28::Real, edu28::Real, const edu28::OffsetDistribution&>(edu28::rollDoubleOverlapBulk),
+        py::call_guard<py::gil_scoped_release>(),
+        "Perform several random double-signal overlap simulations with offsets from an OffsetDistribution"
+    );
     m.def( // With default arguments
         "rollDoubleOverlapBulk",
         [] (
@@ -110,9 +351,868 @@ PYBIND11_MODULE(TORCH_EXTENSION_NAME, m) {
         "Perform several random single signal rolls"
     );
 
+    py::class_<edu28::Binning> binning(m, "Binning");
+    py::enum_<edu28::Binning::Kind>(binning, "Kind")
+        .value("Uniform", edu28::Binning::Kind::Uniform)
+        .value("Log",     edu28::Binning::Kind::Log)
+        .value("Edges",   edu28::Binning::Kind::Edges)
+    ;
+    binning
+        .def_static("uniform", &edu28::Binning::uniform, py::arg("bins"), py::arg("lo"), py::arg("hi"), "Equal bins over [lo, hi]")
+        .def_static("log", &edu28::Binning::log, py::arg("bins"), py::arg("lo"), py::arg("hi"), "Bins of equal width in log(x) over [lo, hi]")
+        .def_static("fromEdges", &edu28::Binning::fromEdges, py::arg("edges"), "Bins between consecutive edges")
+        .def_property_readonly("kind", &edu28::Binning::getKind)
+        .def_property_readonly("bins", &edu28::Binning::bins)
+        .def_property_readonly("lo",   &edu28::Binning::low)
+        .def_property_readonly("hi",   &edu28::Binning::high)
+        .def_property_readonly(
+            "edges",
+            [] (const edu28::Binning& b) {
+                const auto e = b.edges();
+                return py::array_t<double>(e.size(), e.data());
+            }
+        )
+        .def(
+            "find",
+            [] (const edu28::Binning& b, double x) -> std::optional<std::uint64_t> {
+                const auto idx = b.find(x);
+                if (idx == edu28::Binning::npos) return std::nullopt;
+                return idx;
+            },
+            "Bin containing `x`, None if out of range"
+        )
+        .def(py::self == py::self)
+        .def(pickleBinary<edu28::Binning>())
+    ;
+
+    py::class_<edu28::Histogram>(m, "Histogram")
+        .def(py::init<std::size_t, edu28::Real, edu28::Real>(), py::arg("bins"), py::arg("lo"), py::arg("hi"))
+        .def(py::init<edu28::Binning>(), py::arg("binning"))
+        .def_property_readonly("binning", &edu28::Histogram::getBinning)
+        .def_property_readonly("bins",  &edu28::Histogram::bins)
+        .def_property_readonly("lo",    &edu28::Histogram::low)
+        .def_property_readonly("hi",    &edu28::Histogram::high)
+        .def_property_readonly("total", &edu28::Histogram::total)
+        .def_property_readonly(
+            "counts",
+            [] (const edu28::Histogram& h) {
+                const auto& c = h.binCounts();
+                return py::array_t<std::uint64_t>(c.size(), c.data());
+            }
+        )
+        .def_property_readonly(
+            "edges",
+            [] (const edu28::Histogram& h) {
+                const auto e = h.edges();
+                return py::array_t<double>(e.size(), e.data());
+            }
+        )
+        .def(
+            "density",
+            [] (const edu28::Histogram& h) {
+                const auto d = h.density();
+                return py::array_t<edu28::Real>(d.size(), d.data());
+            },
+            "Same as `np.histogram(density=True)`"
+        )
+        .def("__iadd__", &edu28::Histogram::operator+=)
+        .def(pickleBinary<edu28::Histogram>())
+    ;
+
+    py::class_<edu28::SparseHistogram>(m, "SparseHistogram")
+        .def(py::init<std::uint64_t, edu28::Real, edu28::Real>(), py::arg("bins"), py::arg("lo"), py::arg("hi"))
+        .def(py::init<edu28::Binning>(), py::arg("binning"))
+        .def_property_readonly("binning", &edu28::SparseHistogram::getBinning)
+        .def_static("fromDense", &edu28::SparseHistogram::fromDense)
+        .def_property_readonly("bins",  &edu28::SparseHistogram::bins)
+        .def_property_readonly("lo",    &edu28::SparseHistogram::low)
+        .def_property_readonly("hi",    &edu28::SparseHistogram::high)
+        .def_property_readonly("total", &edu28::SparseHistogram::total)
+        .def_property_readonly(
+            "occupiedBins",
+            [] (edu28::SparseHistogram& h) {
+                h.compact();
+                const auto& i = h.occupiedBins();
+                return py::array_t<std::uint64_t>(i.size(), i.data());
+            }
+        )
+        .def_property_readonly(
+            "occupiedCounts",
+            [] (edu28::SparseHistogram& h) {
+                h.compact();
+                const auto& c = h.occupiedCounts();
+                return py::array_t<std::uint64_t>(c.size(), c.data());
+            }
+        )
+        .def(
+            "toDense",
+            [] (const edu28::SparseHistogram& h) {
+                const auto c = h.toDense();
+                return py::array_t<std::uint64_t>(c.size(), c.data());
+            },
+            "Dense bin counts"
+        )
+        .def("toHistogram", &edu28::SparseHistogram::toHistogram, "Dense histogram with the same binning")
+        .def("__iadd__", &edu28::SparseHistogram::operator+=)
+        .def(
+            "saveText",
+            &edu28::SparseHistogram::saveText,
+            py::arg("path"), py::arg("sep") = ' ',
+            py::call_guard<py::gil_scoped_release>(),
+            "Write occupied bins to a text file"
+        )
+        .def_static(
+            "loadText",
+            &edu28::SparseHistogram::loadText,
+            py::arg("path"), py::arg("sep") = ' ',
+            py::call_guard<py::gil_scoped_release>(),
+            "Read a file written by `saveText`"
+        )
+        .def(pickleBinary<edu28::SparseHistogram>())
+    ;
+
+    py::class_<edu28::HdrHistogram>(m, "HdrHistogram")
+        .def(
+            py::init<double, double, double>(),
+            py::arg("lowest"), py::arg("highest"), py::arg("relativeError")
+        )
+        .def_property_readonly("lowest",        &edu28::HdrHistogram::getLowest)
+        .def_property_readonly("highest",       &edu28::HdrHistogram::getHighest)
+        .def_property_readonly("relativeError", &edu28::HdrHistogram::relativeError)
+        .def_property_readonly("subBuckets",    &edu28::HdrHistogram::subBuckets)
+        .def_property_readonly("buckets",       &edu28::HdrHistogram::buckets)
+        .def_property_readonly("footprint",     &edu28::HdrHistogram::footprint)
+        .def_property_readonly("underflow",     &edu28::HdrHistogram::getUnderflow)
+        .def_property_readonly("overflow",      &edu28::HdrHistogram::getOverflow)
+        .def_property_readonly("min",           &edu28::HdrHistogram::min)
+        .def_property_readonly("max",           &edu28::HdrHistogram::max)
+        .def_property_readonly("total",         &edu28::HdrHistogram::total)
+        .def_property_readonly(
+            "counts",
+            [] (const edu28::HdrHistogram& h) {
+                const auto& c = h.bucketCounts();
+                return py::array_t<std::uint64_t>(c.size(), c.data());
+            }
+        )
+        .def_property_readonly(
+            "edges",
+            [] (const edu28::HdrHistogram& h) {
+                const auto e = h.edges();
+                return py::array_t<double>(e.size(), e.data());
+            }
+        )
+        .def("fill", &edu28::HdrHistogram::fill)
+        .def("quantile", &edu28::HdrHistogram::quantile, py::arg("q"), "Value below which a fraction `q` of values lies")
+        .def("tailFraction", &edu28::HdrHistogram::tailFraction, py::arg("x"), "Fraction of values at or above `x`")
+        .def("__iadd__", &edu28::HdrHistogram::operator+=)
+        .def(pickleBinary<edu28::HdrHistogram>())
+    ;
+
+    py::class_<edu28::QuantileSketch>(m, "QuantileSketch")
+        .def(
+            py::init<std::uint32_t, std::uint64_t>(),
+            py::arg("k") = edu28::QuantileSketch::defaultK, py::arg("seed") = 0
+        )
+        .def_property_readonly("k",        &edu28::QuantileSketch::getK)
+        .def_property_readonly("count",    &edu28::QuantileSketch::count)
+        .def_property_readonly("min",      &edu28::QuantileSketch::min)
+        .def_property_readonly("max",      &edu28::QuantileSketch::max)
+        .def_property_readonly("retained", &edu28::QuantileSketch::retained)
+        .def_property_readonly("exact",    &edu28::QuantileSketch::isExact)
+        .def("fill", &edu28::QuantileSketch::fill)
+        .def("rank", &edu28::QuantileSketch::rank, py::arg("x"), "Fraction of values at or below `x`")
+        .def("quantile", &edu28::QuantileSketch::quantile, py::arg("q"), "Value with rank `q`")
+        .def("quantiles", &edu28::QuantileSketch::quantiles, py::arg("qs"), "Values with ranks `qs`")
+        .def("rankError", &edu28::QuantileSketch::rankError, py::arg("rank"), "Standard error of ranks near `rank`")
+        .def("__iadd__", &edu28::QuantileSketch::operator+=)
+        .def(pickleBinary<edu28::QuantileSketch>())
+    ;
+
+    py::class_<edu28::RollSketches>(m, "RollSketches")
+        .def_readonly("integral",  &edu28::RollSketches::integral)
+        .def_readonly("amplitude", &edu28::RollSketches::amplitude)
+        .def("__iadd__", &edu28::RollSketches::operator+=)
+        .def(pickleBinary<edu28::RollSketches>())
+    ;
+
+    py::class_<edu28::BorderCounts>(m, "BorderCounts")
+        .def_readonly("left",  &edu28::BorderCounts::left)
+        .def_readonly("right", &edu28::BorderCounts::right)
+        .def("ratio", &edu28::BorderCounts::ratio)
+        .def(pickleBinary<edu28::BorderCounts>())
+    ;
+
+    py::class_<edu28::Sensitivities> sensitivities(m, "Sensitivities");
+    py::enum_<edu28::Sensitivities::Parameter>(sensitivities, "Parameter")
+        .value("Border", edu28::Sensitivities::Parameter::Border)
+        .value("Scale",  edu28::Sensitivities::Parameter::Scale)
+        .value("Left",   edu28::Sensitivities::Parameter::Left)
+        .value("Right",  edu28::Sensitivities::Parameter::Right)
+    ;
+    sensitivities
+        .def_readonly("border",    &edu28::Sensitivities::border)
+        .def_readonly("bandwidth", &edu28::Sensitivities::bandwidth)
+        .def_readonly("rolls",     &edu28::Sensitivities::rolls)
+        .def_readonly("right",     &edu28::Sensitivities::right)
+        .def_property_readonly("tailFraction", &edu28::Sensitivities::tailFraction)
+        .def_property_readonly("ratio",        &edu28::Sensitivities::ratio)
+        .def("dTail",       &edu28::Sensitivities::dTail,       py::arg("parameter"), "Derivative of the tail fraction")
+        .def("dTailError",  &edu28::Sensitivities::dTailError,  py::arg("parameter"), "Standard error of dTail()")
+        .def("dRatio",      &edu28::Sensitivities::dRatio,      py::arg("parameter"), "Derivative of the pile-up ratio")
+        .def("dRatioError", &edu28::Sensitivities::dRatioError, py::arg("parameter"), "Standard error of dRatio()")
+        .def("__iadd__", &edu28::Sensitivities::operator+=)
+        .def(pickleBinary<edu28::Sensitivities>())
+    ;
+
+    py::class_<edu28::Distribution>(m, "Distribution")
+        .def(py::init<std::vector<edu28::Real>, const std::vector<edu28::Real>&>(), py::arg("E"), py::arg("P"))
+        .def_property_readonly("grid", &edu28::Distribution::grid)
+        .def_property_readonly("cdf",  &edu28::Distribution::cdfTable)
+        .def("min", &edu28::Distribution::min)
+        .def("max", &edu28::Distribution::max)
+        .def("quantile", &edu28::Distribution::quantile, "Inverse CDF")
+        .def("cdfAt", &edu28::Distribution::cdfAt, py::arg("x"), "Probability of a draw not exceeding `x`")
+        .def(pickleBinary<edu28::Distribution>())
+    ;
+
+    py::class_<edu28::MixtureDistribution>(m, "MixtureDistribution")
+        .def(py::init<edu28::Distribution>(), py::arg("distribution"))
+        .def(
+            py::init<std::vector<edu28::Distribution>, std::vector<edu28::Real>>(),
+            py::arg("components"), py::arg("weights"),
+            "Weighted mixture of distributions"
+        )
+        .def_property_readonly("components", &edu28::MixtureDistribution::getComponents)
+        .def_property_readonly("weights",    &edu28::MixtureDistribution::getWeights)
+        .def("min", &edu28::MixtureDistribution::min)
+        .def("max", &edu28::MixtureDistribution::max)
+        .def("cdfAt", &edu28::MixtureDistribution::cdfAt, py::arg("x"), "Probability of a draw not exceeding `x`")
+        .def(pickleBinary<edu28::MixtureDistribution>())
+    ;
+    py::implicitly_convertible<edu28::Distribution, edu28::MixtureDistribution>();
+
+    py::class_<edu28::OffsetDistribution>(m, "OffsetDistribution")
+        .def(
+            py::init<int, const std::vector<edu28::Real>&>(),
+            py::arg("offsetMin"), py::arg("weights"),
+            "Offsets from `offsetMin` on with the given weights"
+        )
+        .def_static(
+            "uniform", &edu28::OffsetDistribution::uniformRange,
+            py::arg("offsetMin"), py::arg("offsetMax"),
+            "Equally likely offsets in [offsetMin, offsetMax]"
+        )
+        .def_static(
+            "exponential", &edu28::OffsetDistribution::exponential,
+            py::arg("offsetMin"), py::arg("offsetMax"), py::arg("rate"), py::arg("deadTime") = 0.0,
+            "Exponential arrival gaps with `rate` per grid unit and a dead time"
+        )
+        .def_property_readonly("min",           &edu28::OffsetDistribution::min)
+        .def_property_readonly("max",           &edu28::OffsetDistribution::max)
+        .def_property_readonly("probabilities", &edu28::OffsetDistribution::probabilities)
+        .def_property_readonly("isUniform",     &edu28::OffsetDistribution::isUniform)
+        .def("probability", &edu28::OffsetDistribution::probability, py::arg("offset"))
+        .def(pickleBinary<edu28::OffsetDistribution>())
+    ;
+    py::class_<edu28::SimulationContext>(m, "SimulationContext")
+        .def(
+            py::init(
+                [] (
+                    edu28::MixtureDistribution amplitudes,
+                    const edu28::Signal& signal,
+                    edu28::Real intLeft, edu28::Real intRight,
+                    int offsetMin, int offsetMax,
+                    std::optional<std::uint64_t> seed
+                ) {
+                    return edu28::SimulationContext(
+                        std::move(amplitudes), signal, intLeft, intRight, offsetMin, offsetMax,
+                        seed ? *seed : edu28::randomSeed()
+                    );
+                }
+            ),
+            py::arg("amplitudes"), py::arg("signal"),
+            py::arg("intLeft"), py::arg("intRight"),
+            py::arg("offsetMin") = 0, py::arg("offsetMax") = 42,
+            py::arg("seed") = py::none(),
+            py::call_guard<py::gil_scoped_release>()
+        )
+        .def(
+            py::init(
+                [] (
+                    edu28::MixtureDistribution amplitudes,
+                    const edu28::Signal& signal,
+                    edu28::Real intLeft, edu28::Real intRight,
+                    edu28::OffsetDistribution offsets,
+                    std::optional<std::uint64_t> seed
+                ) {
+                    return edu28::SimulationContext(
+                        std::move(amplitudes), signal, intLeft, intRight, std::move(offsets),
+                        seed ? *seed : edu28::randomSeed()
+                    );
+                }
+            ),
+            py::arg("amplitudes"), py::arg("signal"),
+            py::arg("intLeft"), py::arg("intRight"),
+            py::arg("offsets"),
+            py::arg("seed") = py::none(),
+            py::call_guard<py::gil_scoped_release>()
+        )
+        .def(
+            py::init(
+                [] (
+                    std::vector<edu28::Real> E, const std::vector<edu28::Real>& P,
+                    const edu28::Signal& signal,
+                    edu28::Real intLeft, edu28::Real intRight,
+                    int offsetMin, int offsetMax,
+                    std::optional<std::uint64_t> seed
+                ) {
+                    return edu28::SimulationContext(
+                        std::move(E), P, signal, intLeft, intRight, offsetMin, offsetMax,
+                        seed ? *seed : edu28::randomSeed()
+                    );
+                }
+            ),
+            py::arg("E"), py::arg("P"), py::arg("signal"),
+            py::arg("intLeft"), py::arg("intRight"),
+            py::arg("offsetMin") = 0, py::arg("offsetMax") = 42,
+            py::arg("seed") = py::none(),
+            py::call_guard<py::gil_scoped_release>()
+        )
+        .def_property_readonly("seed",    &edu28::SimulationContext::getSeed)
+        .def_property_readonly("counter", &edu28::SimulationContext::getCounter)
+        .def_property_readonly("setupHash", &edu28::SimulationContext::setupHash)
+        .def_property_readonly("singleCoef", &edu28::SimulationContext::getSingleCoef)
+        .def_property_readonly("offsetCoef", &edu28::SimulationContext::getOffsetCoef)
+        .def_property_readonly("amplitudes", &edu28::SimulationContext::getAmplitudes)
+        .def_property_readonly("offsets",    &edu28::SimulationContext::getOffsets)
+        .def_property_readonly("offsetMin",  &edu28::SimulationContext::getOffsetMin)
+        .def_property_readonly("offsetMax",  &edu28::SimulationContext::getOffsetMax)
+        .def("integralRange", &edu28::SimulationContext::integralRange)
+        .def(
+            "run",
+            &edu28::SimulationContext::run,
+            py::call_guard<py::gil_scoped_release>(),
+            "Perform `n` double-signal overlap simulations"
+        )
+        .def(
+            "histogram",
+            py::overload_cast<std::size_t, std::size_t>(&edu28::SimulationContext::histogram),
+            py::call_guard<py::gil_scoped_release>(),
+            "Histogram integrals of `n` simulations over the whole integral range"
+        )
+        .def(
+            "histogram",
+            py::overload_cast<std::size_t, std::size_t, edu28::Real, edu28::Real>(&edu28::SimulationContext::histogram),
+            py::call_guard<py::gil_scoped_release>(),
+            "Histogram integrals of `n` simulations over [lo, hi]"
+        )
+        .def(
+            "histogram",
+            py::overload_cast<std::size_t, const edu28::Binning&>(&edu28::SimulationContext::histogram),
+            py::call_guard<py::gil_scoped_release>(),
+            "Histogram integrals of `n` simulations with the given binning"
+        )
+        .def(
+            "sparseHistogram",
+            py::overload_cast<std::size_t, std::uint64_t, edu28::Real, edu28::Real>(&edu28::SimulationContext::sparseHistogram),
+            py::call_guard<py::gil_scoped_release>(),
+            "Histogram integrals of `n` simulations over [lo, hi], storing only occupied bins"
+        )
+        .def(
+            "sparseHistogram",
+            py::overload_cast<std::size_t, const edu28::Binning&>(&edu28::SimulationContext::sparseHistogram),
+            py::call_guard<py::gil_scoped_release>(),
+            "Histogram integrals of `n` simulations with the given binning, storing only occupied bins"
+        )
+        .def(
+            "hdrHistogram",
+            &edu28::SimulationContext::hdrHistogram,
+            py::arg("n"), py::arg("lowest"), py::arg("highest"), py::arg("relativeError"),
+            py::call_guard<py::gil_scoped_release>(),
+            "Histogram integrals of `n` simulations with bounded relative error"
+        )
+        .def(
+            "sketches",
+            &edu28::SimulationContext::sketches,
+            py::arg("n"), py::arg("k") = edu28::QuantileSketch::defaultK,
+            py::call_guard<py::gil_scoped_release>(),
+            "Sketch integral and amplitude quantiles of `n` simulations"
+        )
+        .def(
+            "sensitivities",
+            &edu28::SimulationContext::sensitivities,
+            py::arg("n"), py::arg("border"), py::arg("bandwidth") = 0.0,
+            py::call_guard<py::gil_scoped_release>(),
+            "Derivatives of the tail fraction and pile-up ratio of `n` simulations"
+        )
+        .def(
+            "borderCounts",
+            &edu28::SimulationContext::borderCounts,
+            py::call_guard<py::gil_scoped_release>(),
+            "Count integrals of `n` simulations on either side of the border"
+        )
+        .def(
+            "ratio",
+            &edu28::SimulationContext::ratio,
+            py::call_guard<py::gil_scoped_release>(),
+            "Pile-up ratio of `n` simulations for the border"
+        )
+        .def(
+            "withAmplitudes",
+            &edu28::SimulationContext::withAmplitudes,
+            py::arg("amplitudes"),
+            "Same setup and RNG position with a different amplitude distribution"
+        )
+        .def(
+            "offsetTailProbabilities",
+            &edu28::SimulationContext::offsetTailProbabilities,
+            py::arg("border"),
+            py::call_guard<py::gil_scoped_release>(),
+            "Probability of an integral at or above the border for every offset, without rolling"
+        )
+        .def(
+            "tailFraction",
+            &edu28::SimulationContext::tailFraction,
+            py::arg("border"),
+            py::call_guard<py::gil_scoped_release>(),
+            "Probability of an integral at or above the border, without rolling"
+        )
+        .def(
+            "analyticRatio",
+            &edu28::SimulationContext::analyticRatio,
+            py::arg("border"),
+            py::call_guard<py::gil_scoped_release>(),
+            "Pile-up ratio for the border, without rolling"
+        )
+        .def(
+            "fork", &edu28::SimulationContext::fork,
+            py::arg("n"),
+            "Copy owning the next `n` roll numbers, which this context skips. "
+            "Pickled copies keep the roll position, so send forks rather than copies to worker processes"
+        )
+        .def(pickleBinary<edu28::SimulationContext>())
+    ;
+
+    py::class_<edu28::TailSampler>(m, "TailSampler")
+        .def(
+            py::init(
+                [] (const edu28::SimulationContext& context, edu28::Real border, std::optional<std::uint64_t> seed) {
+                    return edu28::TailSampler(context, border, seed ? *seed : context.getSeed());
+                }
+            ),
+            py::arg("context"), py::arg("border"), py::arg("seed") = py::none(),
+            py::call_guard<py::gil_scoped_release>(),
+            "Sampler of the context's rolls conditioned on `integral >= border`"
+        )
+        .def_property_readonly("border",       &edu28::TailSampler::getBorder)
+        .def_property_readonly("seed",         &edu28::TailSampler::getSeed)
+        .def_property_readonly("counter",      &edu28::TailSampler::getCounter)
+        .def_property_readonly("tailFraction", &edu28::TailSampler::tailFraction)
+        .def("roll", &edu28::TailSampler::roll, py::arg("index"), "Conditional roll number `index`")
+        .def(
+            "run",
+            &edu28::TailSampler::run,
+            py::arg("n"),
+            py::call_guard<py::gil_scoped_release>(),
+            "Perform `n` conditional simulations, all of them tail events"
+        )
+    ;
+
+    py::class_<edu28::RatioEstimate>(m, "RatioEstimate")
+        .def_readonly("ratio",       &edu28::RatioEstimate::ratio)
+        .def_readonly("statError",   &edu28::RatioEstimate::statError)
+        .def_readonly("interpError", &edu28::RatioEstimate::interpError)
+        .def("__repr__", [] (const edu28::RatioEstimate& e) {
+            return "RatioEstimate(ratio=" + std::to_string(e.ratio)
+                + ", statError=" + std::to_string(e.statError)
+                + ", interpError=" + std::to_string(e.interpError) + ")";
+        })
+    ;
+
+    py::class_<edu28::RatioTable>(m, "RatioTable")
+        .def_static(
+            "build",
+            &edu28::RatioTable::build,
+            py::arg("hv"), py::arg("E"), py::arg("counts"), py::arg("signal"),
+            py::arg("lefts"), py::arg("rights"), py::arg("borders"),
+            py::arg("offsets") = edu28::OffsetDistribution::uniformRange(0, 42),
+            py::arg("replicas") = 0, py::arg("seed") = 0,
+            py::call_guard<py::gil_scoped_release>(),
+            "Compute ratios on an HV x left x right x border grid without rolling"
+        )
+        .def_property_readonly("hv",      [] (const edu28::RatioTable& t) { return t.axis(0); })
+        .def_property_readonly("lefts",   [] (const edu28::RatioTable& t) { return t.axis(1); })
+        .def_property_readonly("rights",  [] (const edu28::RatioTable& t) { return t.axis(2); })
+        .def_property_readonly("borders", [] (const edu28::RatioTable& t) { return t.axis(3); })
+        .def_property_readonly("hasErrors", &edu28::RatioTable::hasErrors)
+        .def(
+            "query",
+            &edu28::RatioTable::query,
+            py::arg("hv"), py::arg("left"), py::arg("right"), py::arg("border"),
+            "Interpolated ratio with statistical and interpolation errors"
+        )
+        .def(
+            "save",
+            [] (const edu28::RatioTable& table, const std::string& path) { edu28::saveToFile(path, table); },
+            py::call_guard<py::gil_scoped_release>(),
+            "Write the table to a file"
+        )
+        .def_static(
+            "load",
+            [] (const std::string& path) { return edu28::loadFromFile<edu28::RatioTable>(path); },
+            py::call_guard<py::gil_scoped_release>(),
+            "Read a table written by `save`"
+        )
+        .def(pickleBinary<edu28::RatioTable>())
+    ;
+
+    py::class_<edu28::UnfoldResult>(m, "UnfoldResult")
+        .def_readonly("E",             &edu28::UnfoldResult::E)
+        .def_readonly("probabilities", &edu28::UnfoldResult::probabilities)
+        .def_readonly("density",       &edu28::UnfoldResult::density)
+        .def_readonly("predicted",     &edu28::UnfoldResult::predicted)
+        .def_readonly("logLikelihood", &edu28::UnfoldResult::logLikelihood)
+        .def_readonly("iterations",    &edu28::UnfoldResult::iterations)
+        .def(
+            "distribution",
+            [] (const edu28::UnfoldResult& r) { return edu28::Distribution(r.E, r.density); },
+            "Unfolded spectrum as an amplitude distribution"
+        )
+    ;
+
+    py::class_<edu28::ResponseOperator>(m, "ResponseOperator")
+        .def(
+            py::init<const edu28::SimulationContext&, std::vector<edu28::Real>, edu28::Binning>(),
+            py::arg("setup"), py::arg("E"), py::arg("binning"),
+            py::call_guard<py::gil_scoped_release>(),
+            "Tabulate the map from amplitude cells of `E` to integral bins for the setup's shape, window and offsets"
+        )
+        .def_property_readonly("E",       &edu28::ResponseOperator::grid)
+        .def_property_readonly("cells",   &edu28::ResponseOperator::cells)
+        .def_property_readonly("binning", &edu28::ResponseOperator::getBinning)
+        .def(
+            "probabilitiesOf",
+            &edu28::ResponseOperator::probabilitiesOf,
+            py::arg("amplitudes"),
+            "Probability of every amplitude cell under a distribution"
+        )
+        .def(
+            "singles",
+            &edu28::ResponseOperator::singles,
+            py::arg("f"),
+            py::call_guard<py::gil_scoped_release>(),
+            "Bin probabilities of single events"
+        )
+        .def(
+            "doubles",
+            &edu28::ResponseOperator::doubles,
+            py::arg("f"),
+            py::call_guard<py::gil_scoped_release>(),
+            "Bin probabilities of double events"
+        )
+        .def(
+            "apply",
+            &edu28::ResponseOperator::apply,
+            py::arg("f"), py::arg("pileup"),
+            py::call_guard<py::gil_scoped_release>(),
+            "Bin probabilities of all events, a fraction `pileup` of them double"
+        )
+        .def(
+            "applyAll",
+            &edu28::ResponseOperator::applyAll,
+            py::arg("f"), py::arg("pileup"),
+            py::call_guard<py::gil_scoped_release>(),
+            "`apply` to many spectra in parallel blocks"
+        )
+        .def(
+            "save",
+            [] (const edu28::ResponseOperator& op, const std::string& path) { edu28::saveToFile(path, op); },
+            py::call_guard<py::gil_scoped_release>(),
+            "Write the tables to a file"
+        )
+        .def_static(
+            "load",
+            [] (const std::string& path) { return edu28::loadFromFile<edu28::ResponseOperator>(path); },
+            py::call_guard<py::gil_scoped_release>(),
+            "Read tables written by `save`"
+        )
+        .def(pickleBinary<edu28::ResponseOperator>())
+    ;
+
+    py::class_<edu28::Unfolder>(m, "Unfolder")
+        .def(
+            py::init<const edu28::SimulationContext&, const std::vector<edu28::Real>&>(),
+            py::arg("setup"), py::arg("E"),
+            py::call_guard<py::gil_scoped_release>(),
+            "Tabulate where the setup's doubles land on the amplitude grid `E`"
+        )
+        .def_property_readonly("E",        &edu28::Unfolder::grid)
+        .def_property_readonly("response", &edu28::Unfolder::getResponse)
+        .def(
+            "run",
+            &edu28::Unfolder::run,
+            py::arg("counts"), py::arg("pileup"),
+            py::arg("maxIterations") = 1000, py::arg("tolerance") = 1e-9,
+            py::call_guard<py::gil_scoped_release>(),
+            "Unfold a measured spectrum with the given fraction of double events"
+        )
+        .def(
+            "runAll",
+            &edu28::Unfolder::runAll,
+            py::arg("counts"), py::arg("pileup"),
+            py::arg("maxIterations") = 1000, py::arg("tolerance") = 1e-9,
+            py::call_guard<py::gil_scoped_release>(),
+            "Unfold every spectrum of a scan in parallel"
+        )
+    ;
+
+    py::class_<edu28::BootstrapResult>(m, "BootstrapResult")
+        .def_readonly("ratios", &edu28::BootstrapResult::ratios)
+        .def("mean",     &edu28::BootstrapResult::mean)
+        .def("stddev",   &edu28::BootstrapResult::stddev)
+        .def("quantile", &edu28::BootstrapResult::quantile, py::arg("q"), "Ratio quantile")
+        .def(pickleBinary<edu28::BootstrapResult>())
+    ;
+
+    py::class_<edu28::SpectrumBootstrap>(m, "SpectrumBootstrap")
+        .def(
+            py::init(
+                [] (std::vector<edu28::Real> E, std::vector<edu28::Real> counts, std::optional<std::uint64_t> seed) {
+                    return edu28::SpectrumBootstrap(std::move(E), std::move(counts), seed ? *seed : edu28::randomSeed());
+                }
+            ),
+            py::arg("E"), py::arg("counts"), py::arg("seed") = py::none(),
+            "Poisson bootstrap of raw spectrum counts"
+        )
+        .def_property_readonly("grid",   &edu28::SpectrumBootstrap::grid)
+        .def_property_readonly("counts", &edu28::SpectrumBootstrap::getCounts)
+        .def_property_readonly("seed",   &edu28::SpectrumBootstrap::getSeed)
+        .def("replica", &edu28::SpectrumBootstrap::replica, py::arg("index"), "Counts of one replica")
+        .def(
+            "replicas",
+            [] (const edu28::SpectrumBootstrap& b, std::size_t replicas) {
+                const auto cols = b.grid().size();
+                auto data = [&] {
+                    py::gil_scoped_release release;
+                    return b.replicas(replicas);
+                } ();
+                py::array_t<edu28::Real> ret({ replicas, cols });
+                std::copy(data.begin(), data.end(), ret.mutable_data());
+                return ret;
+            },
+            py::arg("replicas"),
+            "`(replicas, grid size)` array of replica counts"
+        )
+        .def(
+            "ratios",
+            &edu28::SpectrumBootstrap::ratios,
+            py::arg("base"), py::arg("replicas"), py::arg("border"), py::arg("rolls") = 0,
+            py::call_guard<py::gil_scoped_release>(),
+            "Pile-up ratio of every replica, without rolling if `rolls` is 0"
+        )
+    ;
+
+    py::class_<edu28::RunState>(m, "RunState")
+        .def_readonly("seed",      &edu28::RunState::seed)
+        .def_readonly("setup",     &edu28::RunState::setup)
+        .def_readonly("begin",     &edu28::RunState::begin)
+        .def_readonly("end",       &edu28::RunState::end)
+        .def_readonly("border",    &edu28::RunState::border)
+        .def_readonly("histogram", &edu28::RunState::histogram)
+        .def_readonly("counts",    &edu28::RunState::counts)
+        .def_readonly("sketches",  &edu28::RunState::sketches)
+        .def_property_readonly("rolls", &edu28::RunState::rolls)
+        .def("mean",     &edu28::RunState::mean)
+        .def("variance", &edu28::RunState::variance)
+        .def(
+            "save",
+            [] (const edu28::RunState& state, const std::string& path) { edu28::saveToFile(path, state); },
+            py::call_guard<py::gil_scoped_release>(),
+            "Write the state to a file"
+        )
+        .def_static(
+            "load",
+            [] (const std::string& path) { return edu28::loadFromFile<edu28::RunState>(path); },
+            py::call_guard<py::gil_scoped_release>(),
+            "Read a state written by `save`"
+        )
+        .def(pickleBinary<edu28::RunState>())
+    ;
+
+    m.def(
+        "shardRange",
+        edu28::shardRange,
+        "Roll number range of a shard"
+    );
+
+    m.def(
+        "runRange",
+        edu28::runRange,
+        py::call_guard<py::gil_scoped_release>(),
+        "Perform a range of a context's rolls and return a mergeable state"
+    );
+
+    m.def(
+        "runShard",
+        edu28::runShard,
+        py::call_guard<py::gil_scoped_release>(),
+        "Perform a shard of a context's run and return a mergeable state"
+    );
+    m.def( // With default arguments
+        "runShard",
+        [] (
+            const edu28::SimulationContext& context,
+            std::uint64_t totalRolls, std::uint64_t shard, std::uint64_t shards,
+            std::size_t bins, edu28::Real border,
+            std::uint32_t sketchK
+        ) {
+            const auto [ lo, hi ] = context.integralRange();
+            return edu28::runShard(context, totalRolls, shard, shards, bins, lo, hi, border, sketchK);
+        },
+        py::arg("context"), py::arg("totalRolls"), py::arg("shard"), py::arg("shards"),
+        py::arg("bins"), py::arg("border"), py::arg("sketchK") = edu28::QuantileSketch::defaultK,
+        py::call_guard<py::gil_scoped_release>(),
+        "Perform a shard of a context's run and return a mergeable state"
+    );
+
+    m.def(
+        "mergeRunStates",
+        edu28::mergeRunStates,
+        py::call_guard<py::gil_scoped_release>(),
+        "Merge shard states into the state of the whole run"
+    );
+
+    bindRollStream<edu28::DoubleOverlapRollResult>(m, "DoubleOverlapRollStream");
+    bindRollStream<edu28::Real>(m, "SingleRollStream");
+
+    m.def(
+        "rollDoubleOverlapStream",
+        py::overload_cast<std::size_t, std::size_t, std::size_t, const std::vector<edu28::Real>&, const std::vector<edu28::Real>&, const edu28::Signal&, edu28::Real, edu28::Real, int, int>(edu28::rollDoubleOverlapStream),
+        py::call_guard<py::gil_scoped_release>(),
+        "Start double-signal overlap simulations in the background, iterate over result blocks"
+    );
+    m.def(
+        "rollDoubleOverlapStream",
+        py::overload_cast<std::size_t, std::size_t, std::size_t, const std::vector<edu28::Real>&, const std::vector<edu28::Real>&, const edu28::Signal&, edu28::Real, edu28::Real, edu28::OffsetDistribution>(
+            edu28::rollDoubleOverlapStream
+        ),
+        py::call_guard<py::gil_scoped_release>(),
+        "Start double-signal overlap simulations with offsets from an OffsetDistribution in the background"
+    );
+    m.def( // With default arguments
+        "rollDoubleOverlapStream",
+        [] (
+            std::size_t capacity, std::size_t bulkSize, std::size_t blockSize,
+            const std::vector<edu28::Real>& E,
+            const std::vector<edu28::Real>& P,
+            const edu28::Signal& signal,
+            edu28::Real intLeft, edu28::Real intRight
+        ) {
+            return edu28::rollDoubleOverlapStream(
+                capacity, bulkSize, blockSize, E, P, signal, intLeft, intRight, 0, 42
+            );
+        },
+        py::call_guard<py::gil_scoped_release>(),
+        "Start double-signal overlap simulations in the background, iterate over result blocks"
+    );
+
+    m.def(
+        "rollSingleStream",
+        edu28::rollSingleStream,
+        py::call_guard<py::gil_scoped_release>(),
+        "Start single signal rolls in the background, iterate over result blocks"
+    );
+
+    m.def(
+        "rollDoubleOverlapBulkInto",
+        [] (
+            py::array_t<edu28::Real, py::array::c_style> out,
+            const std::vector<edu28::Real>& E,
+            const std::vector<edu28::Real>& P,
+            const edu28::Signal& signal,
+            edu28::Real intLeft, edu28::Real intRight,
+            int offsetMin, int offsetMax
+        ) {
+            if (out.ndim() != 2 || out.shape(1) != 4) {
+                throw std::runtime_error("rollDoubleOverlapBulkInto expects an (n, 4) array");
+            }
+            if (!out.writeable()) {
+                throw py::value_error("rollDoubleOverlapBulkInto expects a writeable `out` array");
+            }
+
+            const auto rows = static_cast<std::size_t>(out.shape(0));
+            auto* data = out.mutable_data();
+
+            py::gil_scoped_release release;
+            return edu28::rollDoubleOverlapBulkInto(data, rows, E, P, signal, intLeft, intRight, offsetMin, offsetMax);
+        },
+        // No conversion: rolls written into a converted copy would be lost
+        py::arg("out").noconvert(), py::arg("E"), py::arg("P"), py::arg("signal"),
+        py::arg("intLeft"), py::arg("intRight"), py::arg("offsetMin") = 0, py::arg("offsetMax") = 42,
+        "Perform double-signal overlap simulations writing rows of `offset, amp1, amp2, integral` into `out`, "
+        "a writeable C-contiguous array of the module's Real type"
+    );
+    m.def(
+        "rollDoubleOverlapBulkInto",
+        [] (
+            py::array_t<edu28::Real, py::array::c_style> out,
+            const std::vector<edu28::Real>& E,
+            const std::vector<edu28::Real>& P,
+            const edu28::Signal& signal,
+            edu28::Real intLeft, edu28::Real intRight,
+            const edu28::OffsetDistribution& offsets
+        ) {
+            if (out.ndim() != 2 || out.shape(1) != 4) {
+                throw std::runtime_error("rollDoubleOverlapBulkInto expects an (n, 4) array");
+            }
+            if (!out.writeable()) {
+                throw py::value_error("rollDoubleOverlapBulkInto expects a writeable `out` array");
+            }
+
+            const auto rows = static_cast<std::size_t>(out.shape(0));
+            auto* data = out.mutable_data();
+
+            py::gil_scoped_release release;
+            return edu28::rollDoubleOverlapBulkInto(data, rows, E, P, signal, intLeft, intRight, offsets);
+        },
+        py::arg("out").noconvert(), py::arg("E"), py::arg("P"), py::arg("signal"),
+        py::arg("intLeft"), py::arg("intRight"), py::arg("offsets"),
+        "Same with offsets from an OffsetDistribution"
+    );
+
+    m.def(
+        "toArray",
+        [] (const edu28::BulkVector<edu28::DoubleOverlapRollResult>& res) {
+            edu28::detail::checkMemoryBudget(
+                edu28::detail::bytesFor<edu28::Real>(4 * res.size()), "toArray() of " + std::to_string(res.size()) + " rolls"
+            );
+
+            py::array_t<edu28::Real> ret({ static_cast<py::ssize_t>(res.size()), py::ssize_t{ 4 } });
+            auto* data = ret.mutable_data();
+            {
+                py::gil_scoped_release release;
+                for (std::size_t i = 0; i < res.size(); ++i) {
+                    data[4 * i + 0] = static_cast<edu28::Real>(res[i].offset);
+                    data[4 * i + 1] = res[i].amp1;
+                    data[4 * i + 2] = res[i].amp2;
+                    data[4 * i + 3] = res[i].integral;
+                }
+            }
+
+            return ret;
+        },
+        "Convert DoubleOverlapRollResult's to an (n, 4) numpy array"
+    );
+
     m.def(
         "toList",
-        [] (const std::vector<edu28::DoubleOverlapRollResult>& res) {
+        [] (const edu28::BulkVector<edu28::DoubleOverlapRollResult>& res) {
+            // Every row is a separate vector
+            edu28::detail::checkMemoryBudget(
+                res.size() * (sizeof(std::vector<edu28::Real>) + 4 * sizeof(edu28::Real)),
+                "toList() of " + std::to_string(res.size()) + " rolls"
+            );
+
             std::vector<std::vector<edu28::Real>> ret(res.size(), std::vector<edu28::Real>(4));
 
             for (std::size_t i = 0; i < res.size(); ++i) {
@@ -0,0 +1,821 @@
+#pragma once
+
+// Standard library
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "alloc.hh"
+#include "base.hh"
+#include "serial.hh"
+
+namespace edu28 {
+
+/**
+ * \brief Histogram bin layout: uniform, logarithmic or arbitrary edges
+ *
+ * Follows `np.histogram` conventions: bins are half-open except the last
+ * one, which includes the upper edge. Uniform and logarithmic bins are
+ * located in O(1) and then nudged by at most one bin to agree exactly with
+ * \ref edge(). Arbitrary edges use a branchless binary search.
+ */
+class Binning {
+public:
+    /// \brief Bin layout kind
+    enum class Kind : std::uint8_t { Uniform, Log, Edges };
+
+    /// \brief Returned by \ref find() for values outside of the range
+    static constexpr std::uint64_t npos = std::numeric_limits<std::uint64_t>::max();
+
+private:
+    Kind kind = Kind::Uniform;
+    std::uint64_t nBins = 1;
+    double lo = 0;
+    double hi = 1;
+    /// \brief Bins per unit of `x` (uniform) or of `log(x)` (logarithmic)
+    double scale = 1;
+    /// \brief Uniform bin width, edges are `lo + i * delta` like `np.linspace`
+    double delta = 1;
+    /// \brief Bin edges, only for \ref Kind::Edges
+    std::vector<double> edgeTable;
+
+    Binning(Kind kind, std::uint64_t bins, double lo, double hi)
+        : kind(kind), nBins(bins), lo(lo), hi(hi)
+    {
+        if (bins == 0 || !(hi > lo)) {
+            throw std::runtime_error("Binning expects a positive number of bins and lo < hi");
+        }
+        scale = (kind == Kind::Log)
+            ? static_cast<double>(bins) / (std::log(hi) - std::log(lo))
+            : static_cast<double>(bins) / (hi - lo);
+        delta = (hi - lo) / static_cast<double>(bins);
+    } // <-- Binning()
+
+public:
+    /// \brief A single bin over [0, 1]
+    Binning() = default;
+
+    /// \brief `bins` equal bins over [lo, hi]
+    static Binning uniform(std::uint64_t bins, double lo, double hi) {
+        return Binning(Kind::Uniform, bins, lo, hi);
+    } // <-- uniform()
+
+    /**
+     * \brief `bins` bins over [lo, hi] with equal width in `log(x)`
+     *
+     * \throws std::runtime_error if `lo` isn't positive
+     */
+    static Binning log(std::uint64_t bins, double lo, double hi) {
+        if (!(lo > 0)) throw std::runtime_error("Logarithmic binning expects lo > 0");
+        return Binning(Kind::Log, bins, lo, hi);
+    } // <-- log()
+
+    /**
+     * \brief Bins between consecutive `edges`
+     *
+     * \throws std::runtime_error if there are less than two edges or they
+     *         aren't strictly increasing
+     */
+    static Binning fromEdges(std::vector<double> edges) {
+        if (edges.size() < 2 || std::adjacent_find(edges.begin(), edges.end(), std::greater_equal<>()) != edges.end()) {
+            throw std::runtime_error("Binning expects at least two strictly increasing edges");
+        }
+        Binning ret(Kind::Edges, edges.size() - 1, edges.front(), edges.back());
+        ret.edgeTable = std::move(edges);
+        return ret;
+    } // <-- fromEdges()
+
+    /// \brief Bin layout kind
+    Kind getKind() const { return kind; }
+    /// \brief Number of bins
+    std::uint64_t bins() const { return nBins; }
+    /// \brief Lower range boundary
+    double low() const { return lo; }
+    /// \brief Upper range boundary
+    double high() const { return hi; }
+
+    /// \brief Edge number `i` in [0, bins()]
+    double edge(std::uint64_t i) const {
+        // Range boundaries are exact, `exp(log(lo))` may round away from `lo`
+        if (i == 0) return lo;
+        if (i == nBins) return hi;
+
+        switch (kind) {
+        case Kind::Log:
+            return std::exp(std::log(lo) + static_cast<double>(i) / scale);
+        case Kind::Edges:
+            return edgeTable[i];
+        default:
+            return lo + static_cast<double>(i) * delta;
+        }
+    } // <-- edge()
+
+    /// \brief All `bins() + 1` edges
+    std::vector<double> edges() const {
+        if (kind == Kind::Edges) return edgeTable;
+
+        std::vector<double> ret(nBins + 1);
+        for (std::uint64_t i = 0; i <= nBins; ++i) ret[i] = edge(i);
+        return ret;
+    } // <-- edges()
+
+    /// \brief Bin containing `x` or \ref npos
+    std::uint64_t find(double x) const {
+        if (!(x >= lo && x <= hi)) return npos;
+
+        if (kind == Kind::Edges) {
+            // Last edge <= x
+            const double* base = edgeTable.data();
+            std::size_t n = edgeTable.size();
+            while (n > 1) {
+                const auto half = n / 2;
+                base = (base[half] <= x) ? base + half : base;
+                n -= half;
+            }
+            return std::min<std::uint64_t>(base - edgeTable.data(), nBins - 1);
+        }
+
+        // Same index estimate as `np.histogram`: `(x - lo) * (n / (hi - lo))`
+        const double pos = (kind == Kind::Log) ? (std::log(x) - std::log(lo)) * scale : (x - lo) * scale;
+        auto idx = std::min(static_cast<std::uint64_t>(pos), nBins - 1);
+
+        // Rounding may put `x` one bin off its edges
+        if (idx > 0 && x < edge(idx)) {
+            --idx;
+        } else if (idx + 1 < nBins && x >= edge(idx + 1)) {
+            ++idx;
+        }
+
+        return idx;
+    } // <-- find()
+
+    bool operator==(const Binning& other) const {
+        return kind == other.kind && nBins == other.nBins
+            && lo == other.lo && hi == other.hi && edgeTable == other.edgeTable;
+    } // <-- operator==()
+
+    void save(BinaryWriter& w) const {
+        w.write(kind);
+        w.write(nBins);
+        w.write(lo);
+        w.write(hi);
+        w.write(edgeTable);
+    } // <-- save()
+
+    static Binning load(BinaryReader& r) {
+        const auto kind = r.read<Kind>();
+        const auto bins = r.read<std::uint64_t>();
+        const auto lo = r.read<double>();
+        const auto hi = r.read<double>();
+        auto edges = r.readVector<double>();
+
+        switch (kind) {
+        case Kind::Log:
+            return log(bins, lo, hi);
+        case Kind::Edges:
+            return fromEdges(std::move(edges));
+        default:
+            return uniform(bins, lo, hi);
+        }
+    } // <-- load()
+}; // <-- class Binning
+
+/// \brief Implementation detail namespace
+namespace detail {
+
+    /**
+     * \brief Density from bin counts, computed like `np.histogram(density=True)`
+     */
+    std::vector<Real> binDensity(const Binning& binning, const BulkVector<std::uint64_t>& counts) {
+        double total = 0;
+        for (auto c : counts) total += static_cast<double>(c);
+
+        std::vector<Real> ret(counts.size());
+        for (std::size_t i = 0; i < counts.size(); ++i) {
+            const auto width = binning.edge(i + 1) - binning.edge(i);
+            ret[i] = static_cast<Real>(static_cast<double>(counts[i]) / width / total);
+        }
+        return ret;
+    } // <-- binDensity()
+
+} // <-- namespace detail
+
+/**
+ * \brief Histogram storing every bin
+ *
+ * Values outside of the binning range are dropped
+ */
+class Histogram {
+    Binning binning;
+    BulkVector<std::uint64_t> counts = BulkVector<std::uint64_t>(1, 0);
+
+public:
+    Histogram() = default;
+
+    /// \brief Empty histogram with the given binning
+    explicit Histogram(Binning binning) : binning(std::move(binning)), counts(this->binning.bins(), 0) {}
+
+    /**
+     * \brief `bins` uniform bins over [lo, hi]
+     *
+     * \throws std::runtime_error if `bins` is zero or the range is empty
+     */
+    Histogram(std::size_t bins, Real lo, Real hi) : Histogram(Binning::uniform(bins, lo, hi)) {}
+
+    /**
+     * \brief Histogram with given bin counts
+     *
+     * \throws std::runtime_error if the number of counts doesn't match the binning
+     */
+    Histogram(Binning binning, BulkVector<std::uint64_t> counts)
+        : binning(std::move(binning)), counts(std::move(counts))
+    {
+        if (this->counts.size() != this->binning.bins()) {
+            throw std::runtime_error("Histogram expects one count per bin");
+        }
+    } // <-- Histogram()
+
+    /// \brief Add a value
+    void fill(Real x) {
+        const auto idx = binning.find(x);
+        if (idx != Binning::npos) ++counts[idx];
+    } // <-- fill()
+
+    /**
+     * \brief Merge another histogram into this one
+     *
+     * \throws std::runtime_error if binnings differ
+     */
+    Histogram& operator+=(const Histogram& other) {
+        if (!(other.binning == binning)) {
+            throw std::runtime_error("Can't merge histograms with different binning");
+        }
+
+        for (std::size_t i = 0; i < counts.size(); ++i) counts[i] += other.counts[i];
+
+        return *this;
+    } // <-- operator+=()
+
+    /// \brief Bin layout
+    const Binning& getBinning() const { return binning; }
+    /// \brief Number of bins
+    std::size_t bins() const { return counts.size(); }
+    /// \brief Lower range boundary
+    Real low() const { return static_cast<Real>(binning.low()); }
+    /// \brief Upper range boundary
+    Real high() const { return static_cast<Real>(binning.high()); }
+
+    /// \brief Bin counts
+    const BulkVector<std::uint64_t>& binCounts() const { return counts; }
+
+    /// \brief Total number of values in range
+    std::uint64_t total() const {
+        std::uint64_t ret = 0;
+        for (auto c : counts) ret += c;
+        return ret;
+    } // <-- total()
+
+    /// \brief Bin edges, `bins() + 1` values
+    std::vector<double> edges() const { return binning.edges(); }
+
+    /// \brief Probability density in every bin, same as `np.histogram(density=True)`
+    std::vector<Real> density() const { return detail::binDensity(binning, counts); }
+
+    void save(BinaryWriter& w) const {
+        binning.save(w);
+        w.write(counts);
+    } // <-- save()
+
+    static Histogram load(BinaryReader& r) {
+        auto binning = Binning::load(r);
+        return Histogram(std::move(binning), r.readVector<std::uint64_t, BulkAllocator<std::uint64_t>>());
+    } // <-- load()
+}; // <-- class Histogram
+
+/**
+ * \brief Histogram that only stores occupied bins
+ *
+ * Same binning conventions as \ref Histogram. Occupied bins are kept as
+ * sorted (bin, count) pairs. Fills go into a hash map first and get merged
+ * into the sorted arrays in batches, so memory scales with the number of
+ * occupied bins, not the total bin count.
+ */
+class SparseHistogram {
+    /// \brief Pending fills merged into the sorted arrays once there are this many
+    static constexpr std::size_t compactThreshold = 1 << 16;
+
+    Binning binning;
+
+    BulkVector<std::uint64_t> index;
+    BulkVector<std::uint64_t> count;
+    std::unordered_map<std::uint64_t, std::uint64_t> pending;
+
+    /// \brief Merge sorted `(bin, count)` arrays into this histogram
+    void mergeSorted(const BulkVector<std::uint64_t>& oIndex, const BulkVector<std::uint64_t>& oCount) {
+        BulkVector<std::uint64_t> newIndex, newCount;
+        newIndex.reserve(index.size() + oIndex.size());
+        newCount.reserve(index.size() + oIndex.size());
+
+        std::size_t i = 0, j = 0;
+        while (i < index.size() || j < oIndex.size()) {
+            if (j == oIndex.size() || (i < index.size() && index[i] < oIndex[j])) {
+                newIndex.push_back(index[i]);
+                newCount.push_back(count[i++]);
+            } else if (i == index.size() || oIndex[j] < index[i]) {
+                newIndex.push_back(oIndex[j]);
+                newCount.push_back(oCount[j++]);
+            } else {
+                newIndex.push_back(index[i]);
+                newCount.push_back(count[i++] + oCount[j++]);
+            }
+        }
+
+        index = std::move(newIndex);
+        count = std::move(newCount);
+    } // <-- mergeSorted()
+
+public:
+    SparseHistogram() = default;
+
+    /// \brief Empty histogram with the given binning
+    explicit SparseHistogram(Binning binning) : binning(std::move(binning)) {}
+
+    /**
+     * \brief `bins` uniform bins over [lo, hi]
+     *
+     * \throws std::runtime_error if `bins` is zero or the range is empty
+     */
+    SparseHistogram(std::uint64_t bins, Real lo, Real hi) : SparseHistogram(Binning::uniform(bins, lo, hi)) {}
+
+    /// \brief Sparse copy of a dense histogram
+    static SparseHistogram fromDense(const Histogram& h) {
+        SparseHistogram ret(h.getBinning());
+        const auto& c = h.binCounts();
+        for (std::size_t i = 0; i < c.size(); ++i) {
+            if (c[i] == 0) continue;
+            ret.index.push_back(i);
+            ret.count.push_back(c[i]);
+        }
+        return ret;
+    } // <-- fromDense()
+
+    /// \brief Add a value
+    void fill(Real x) {
+        const auto idx = binning.find(x);
+        if (idx == Binning::npos) return;
+
+        ++pending[idx];
+
+        if (pending.size() >= compactThreshold) compact();
+    } // <-- fill()
+
+    /// \brief Merge pending fills into the sorted arrays
+    void compact() {
+        if (pending.empty()) return;
+
+        std::vector<std::pair<std::uint64_t, std::uint64_t>> sorted(pending.begin(), pending.end());
+        std::sort(sorted.begin(), sorted.end());
+        pending.clear();
+
+        BulkVector<std::uint64_t> oIndex(sorted.size()), oCount(sorted.size());
+        for (std::size_t i = 0; i < sorted.size(); ++i) {
+            oIndex[i] = sorted[i].first;
+            oCount[i] = sorted[i].second;
+        }
+        mergeSorted(oIndex, oCount);
+    } // <-- compact()
+
+    /**
+     * \brief Merge another histogram into this one
+     *
+     * \throws std::runtime_error if binnings differ
+     */
+    SparseHistogram& operator+=(const SparseHistogram& other) {
+        if (!(other.binning == binning)) {
+            throw std::runtime_error("Can't merge histograms with different binning");
+        }
+
+        for (const auto& [ idx, c ] : other.pending) pending[idx] += c;
+        compact();
+        mergeSorted(other.index, other.count);
+
+        return *this;
+    } // <-- operator+=()
+
+    /// \brief Bin layout
+    const Binning& getBinning() const { return binning; }
+    /// \brief Number of bins
+    std::uint64_t bins() const { return binning.bins(); }
+    /// \brief Lower range boundary
+    Real low() const { return static_cast<Real>(binning.low()); }
+    /// \brief Upper range boundary
+    Real high() const { return static_cast<Real>(binning.high()); }
+
+    /// \brief Sorted indices of occupied bins. Call \ref compact() first
+    const BulkVector<std::uint64_t>& occupiedBins() const { return index; }
+    /// \brief Counts of occupied bins. Call \ref compact() first
+    const BulkVector<std::uint64_t>& occupiedCounts() const { return count; }
+
+    /// \brief Total number of values in range
+    std::uint64_t total() const {
+        std::uint64_t ret = 0;
+        for (auto c : count) ret += c;
+        for (const auto& [ idx, c ] : pending) ret += c;
+        return ret;
+    } // <-- total()
+
+    /// \brief Dense bin counts
+    BulkVector<std::uint64_t> toDense() const {
+        BulkVector<std::uint64_t> ret(binning.bins(), 0);
+        for (std::size_t i = 0; i < index.size(); ++i) ret[index[i]] = count[i];
+        for (const auto& [ idx, c ] : pending) ret[idx] += c;
+        return ret;
+    } // <-- toDense()
+
+    /// \brief Dense histogram with the same binning
+    Histogram toHistogram() const {
+        return Histogram(binning, toDense());
+    } // <-- toHistogram()
+
+    void save(BinaryWriter& w) const {
+        SparseHistogram copy = *this;
+        copy.compact();
+
+        binning.save(w);
+        w.write(copy.index);
+        w.write(copy.count);
+    } // <-- save()
+
+    static SparseHistogram load(BinaryReader& r) {
+        SparseHistogram ret(Binning::load(r));
+        ret.index = r.readVector<std::uint64_t, BulkAllocator<std::uint64_t>>();
+        ret.count = r.readVector<std::uint64_t, BulkAllocator<std::uint64_t>>();
+        if (ret.index.size() != ret.count.size()) throw std::runtime_error("Corrupted serialized SparseHistogram");
+
+        // Occupied bins are indexed without checks, they must be in range, sorted and unique
+        for (std::size_t i = 0; i < ret.index.size(); ++i) {
+            if (ret.index[i] >= ret.bins() || (i > 0 && ret.index[i] <= ret.index[i - 1]) || ret.count[i] == 0) {
+                throw std::runtime_error("Corrupted serialized SparseHistogram");
+            }
+        }
+        return ret;
+    } // <-- load()
+
+    /**
+     * \brief Write the histogram as text
+     *
+     * The first line is `# sparse <bins> <lo> <hi>` for uniform binning or
+     * `# sparse-log <bins> <lo> <hi>` for logarithmic binning. Arbitrary
+     * edges get `# sparse-edges <bins> <lo> <hi>` and a `# <edge> <edge> ...`
+     * line. Then follows one `<bin><sep><left edge><sep><count>` line per
+     * occupied bin
+     *
+     * \throws std::runtime_error on I/O errors
+     */
+    void saveText(const std::string& path, char sep = ' ') const {
+        SparseHistogram copy = *this;
+        copy.compact();
+
+        std::ofstream file(path);
+        file << std::setprecision(std::numeric_limits<double>::max_digits10);
+        switch (binning.getKind()) {
+        case Binning::Kind::Log:   file << "# sparse-log";   break;
+        case Binning::Kind::Edges: file << "# sparse-edges"; break;
+        default:                   file << "# sparse";
+        }
+        file << sep << binning.bins() << sep << binning.low() << sep << binning.high() << '\n';
+
+        if (binning.getKind() == Binning::Kind::Edges) {
+            file << '#';
+            for (const auto e : binning.edges()) file << sep << e;
+            file << '\n';
+        }
+
+        for (std::size_t i = 0; i < copy.index.size(); ++i) {
+            file << copy.index[i] << sep << binning.edge(copy.index[i]) << sep << copy.count[i] << '\n';
+        }
+        if (!file) throw std::runtime_error("Can't write " + path);
+    } // <-- saveText()
+
+    /**
+     * \brief Read a histogram written by \ref saveText()
+     *
+     * \throws std::runtime_error on I/O errors or malformed files
+     */
+    static SparseHistogram loadText(const std::string& path, char sep = ' ') {
+        std::ifstream file(path);
+        if (!file) throw std::runtime_error("Can't read " + path);
+
+        const auto split = [sep] (const std::string& line) {
+            std::vector<std::string> ret;
+            std::stringstream ss(line);
+            for (std::string field; std::getline(ss, field, sep); ) {
+                if (!field.empty()) ret.push_back(field);
+            }
+            return ret;
+        };
+
+        std::string line;
+        std::getline(file, line);
+        const auto header = split(line);
+        if (header.size() != 5 || header[0] != "#") {
+            throw std::runtime_error(path + " is not a sparse histogram file");
+        }
+
+        const auto bins = std::stoull(header[2]);
+        const auto lo = std::stod(header[3]);
+        const auto hi = std::stod(header[4]);
+
+        SparseHistogram ret;
+        if (header[1] == "sparse") {
+            ret = SparseHistogram(Binning::uniform(bins, lo, hi));
+        } else if (header[1] == "sparse-log") {
+            ret = SparseHistogram(Binning::log(bins, lo, hi));
+        } else if (header[1] == "sparse-edges") {
+            std::getline(file, line);
+            const auto fields = split(line);
+            if (fields.size() != bins + 2 || fields[0] != "#") {
+                throw std::runtime_error(path + " has a malformed edges line");
+            }
+
+            std::vector<double> edges;
+            for (std::size_t i = 1; i < fields.size(); ++i) edges.push_back(std::stod(fields[i]));
+            ret = SparseHistogram(Binning::fromEdges(std::move(edges)));
+        } else {
+            throw std::runtime_error(path + " is not a sparse histogram file");
+        }
+
+        while (std::getline(file, line)) {
+            const auto fields = split(line);
+            if (fields.empty()) continue;
+            if (fields.size() != 3) throw std::runtime_error(path + " has a malformed line: " + line);
+
+            const auto idx = std::stoull(fields[0]);
+            if (idx >= ret.bins() || (!ret.index.empty() && idx <= ret.index.back())) {
+                throw std::runtime_error(path + " has bins out of range or out of order");
+            }
+            const auto c = std::stoull(fields[2]);
+            if (c == 0) throw std::runtime_error(path + " has an empty bin listed");
+            ret.index.push_back(idx);
+            ret.count.push_back(c);
+        }
+
+        return ret;
+    } // <-- loadText()
+}; // <-- class SparseHistogram
+
+/**
+ * \brief High dynamic range histogram with bounded relative error
+ *
+ * Values are quantized in units of `lowest`. The first `2 * subBuckets`
+ * buckets are linear with width `lowest`, and every following group of
+ * `subBuckets` buckets covers a range twice as wide as the previous one.
+ * A bucket is thus never wider than `1 / subBuckets` of its lower bound,
+ * and reporting bucket midpoints gives a relative error of at most
+ * \ref relativeError() for values above `lowest * subBuckets`.
+ *
+ * The bucket array is allocated once, so histograms from several threads
+ * are merged by adding counts.
+ */
+class HdrHistogram {
+    double lowest = 1;
+    double highest = 1;
+    /// \brief log2 of the number of sub-buckets per power of two
+    unsigned subBits = 1;
+
+    BulkVector<std::uint64_t> counts = BulkVector<std::uint64_t>(4, 0);
+    /// \brief Values below zero and NaN
+    std::uint64_t underflow = 0;
+    /// \brief Values above `highest`
+    std::uint64_t overflow = 0;
+    double minValue = std::numeric_limits<double>::infinity();
+    double maxValue = -std::numeric_limits<double>::infinity();
+
+    /// \brief Bucket of a value in units of `lowest`
+    std::size_t bucketOf(std::uint64_t v) const {
+        const auto sub = std::uint64_t{ 1 } << subBits;
+        if (v < sub) return static_cast<std::size_t>(v);
+
+        const auto shift = static_cast<unsigned>(std::bit_width(v)) - 1 - subBits;
+        return static_cast<std::size_t>((shift + 1) * sub + ((v >> shift) - sub));
+    } // <-- bucketOf()
+
+    /// \brief Bucket `i` bounds in units of `lowest`
+    std::pair<std::uint64_t, std::uint64_t> bucketRange(std::size_t i) const {
+        const auto sub = std::uint64_t{ 1 } << subBits;
+        if (i < sub) return { i, i + 1 };
+
+        const auto shift = static_cast<unsigned>(i / sub - 1);
+        const auto from = (i % sub + sub) << shift;
+        return { from, from + (std::uint64_t{ 1 } << shift) };
+    } // <-- bucketRange()
+
+public:
+    HdrHistogram() = default;
+
+    /**
+     * \param lowest        - value resolution, values in [0, lowest) share one bucket
+     * \param highest       - largest value tracked, larger values are only counted
+     * \param relativeError - largest acceptable relative error of reported values
+     *
+     * \throws std::runtime_error if `0 < lowest < highest` or `0 < relativeError < 0.5`
+     *         don't hold, or the range needs more than 2^63 units of `lowest`
+     */
+    HdrHistogram(double lowest, double highest, double relativeError)
+        : lowest(lowest), highest(highest)
+    {
+        if (!(lowest > 0 && highest > lowest)) {
+            throw std::runtime_error("HdrHistogram expects 0 < lowest < highest");
+        }
+        if (!(relativeError > 0 && relativeError < 0.5)) {
+            throw std::runtime_error("HdrHistogram expects 0 < relativeError < 0.5");
+        }
+        if (highest / lowest >= 0x1.0p63) {
+            throw std::runtime_error("HdrHistogram range is too wide for its resolution");
+        }
+
+        // Midpoints are off by at most half a bucket
+        subBits = std::max(1, static_cast<int>(std::ceil(std::log2(0.5 / relativeError))));
+        counts.assign(bucketOf(static_cast<std::uint64_t>(highest / lowest)) + 1, 0);
+    } // <-- HdrHistogram()
+
+    /// \brief Add a value
+    void fill(Real x) {
+        const double v = x;
+
+        // NaN goes here too, it has no bucket and no place among min and max
+        if (!(v >= 0)) {
+            ++underflow;
+            if (v < 0) minValue = std::min(minValue, v);
+            return;
+        }
+
+        minValue = std::min(minValue, v);
+        maxValue = std::max(maxValue, v);
+
+        if (v > highest) {
+            ++overflow;
+        } else {
+            ++counts[bucketOf(static_cast<std::uint64_t>(v / lowest))];
+        }
+    } // <-- fill()
+
+    /**
+     * \brief Merge another histogram into this one
+     *
+     * \throws std::runtime_error if the configurations differ
+     */
+    HdrHistogram& operator+=(const HdrHistogram& other) {
+        if (other.lowest != lowest || other.highest != highest || other.subBits != subBits) {
+            throw std::runtime_error("Can't merge HDR histograms with different configurations");
+        }
+
+        for (std::size_t i = 0; i < counts.size(); ++i) counts[i] += other.counts[i];
+        underflow += other.underflow;
+        overflow += other.overflow;
+        minValue = std::min(minValue, other.minValue);
+        maxValue = std::max(maxValue, other.maxValue);
+
+        return *this;
+    } // <-- operator+=()
+
+    /// \brief Value resolution
+    double getLowest() const { return lowest; }
+    /// \brief Largest tracked value
+    double getHighest() const { return highest; }
+    /// \brief Guaranteed relative error of \ref quantile() above `lowest * subBuckets()`
+    double relativeError() const { return std::ldexp(1.0, -static_cast<int>(subBits) - 1); }
+    /// \brief Linear sub-buckets per power of two
+    std::uint64_t subBuckets() const { return std::uint64_t{ 1 } << subBits; }
+    /// \brief Number of buckets
+    std::size_t buckets() const { return counts.size(); }
+    /// \brief Memory used by bucket counts, in bytes
+    std::size_t footprint() const { return counts.size() * sizeof(std::uint64_t); }
+
+    /// \brief Number of values below zero or NaN
+    std::uint64_t getUnderflow() const { return underflow; }
+    /// \brief Number of values above \ref getHighest()
+    std::uint64_t getOverflow() const { return overflow; }
+    /// \brief Smallest value added
+    double min() const { return minValue; }
+    /// \brief Largest value added
+    double max() const { return maxValue; }
+
+    /// \brief Total number of values, including out of range ones
+    std::uint64_t total() const {
+        std::uint64_t ret = underflow + overflow;
+        for (auto c : counts) ret += c;
+        return ret;
+    } // <-- total()
+
+    /// \brief Bucket counts
+    const BulkVector<std::uint64_t>& bucketCounts() const { return counts; }
+
+    /// \brief Bucket edges, `buckets() + 1` values
+    std::vector<double> edges() const {
+        std::vector<double> ret(counts.size() + 1);
+        for (std::size_t i = 0; i < counts.size(); ++i) {
+            ret[i] = static_cast<double>(bucketRange(i).first) * lowest;
+        }
+        ret.back() = static_cast<double>(bucketRange(counts.size() - 1).second) * lowest;
+        return ret;
+    } // <-- edges()
+
+    /**
+     * \brief Value below which a fraction `q` of the values lies
+     *
+     * Returns the midpoint of the bucket holding the value of rank
+     * `ceil(q * total())`, or \ref min() / \ref max() if it falls out of range
+     *
+     * \throws std::runtime_error if the histogram is empty or `q` isn't in [0, 1]
+     */
+    double quantile(double q) const {
+        if (!(q >= 0 && q <= 1)) throw std::runtime_error("Quantile must be in [0, 1]");
+
+        const auto n = total();
+        if (n == 0) throw std::runtime_error("Quantile of an empty histogram");
+
+        const auto rank = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(std::ceil(q * static_cast<double>(n))));
+
+        std::uint64_t seen = underflow;
+        if (rank <= seen) return minValue;
+
+        for (std::size_t i = 0; i < counts.size(); ++i) {
+            seen += counts[i];
+            if (rank <= seen) {
+                const auto [ from, to ] = bucketRange(i);
+                const auto mid = 0.5 * static_cast<double>(from + to) * lowest;
+                return std::clamp(mid, minValue, maxValue);
+            }
+        }
+
+        return maxValue;
+    } // <-- quantile()
+
+    /**
+     * \brief Fraction of values at or above `x`
+     *
+     * Values in the bucket containing `x` are assumed to be spread uniformly
+     */
+    double tailFraction(double x) const {
+        const auto n = total();
+        if (n == 0 || std::isnan(x)) return 0;
+        if (x <= 0) return static_cast<double>(n - underflow) / static_cast<double>(n);
+        if (x > highest) return static_cast<double>(overflow) / static_cast<double>(n);
+
+        const auto v = x / lowest;
+        const auto b = bucketOf(static_cast<std::uint64_t>(v));
+        const auto [ from, to ] = bucketRange(b);
+
+        double ret = static_cast<double>(overflow);
+        for (std::size_t i = b + 1; i < counts.size(); ++i) ret += static_cast<double>(counts[i]);
+        ret += static_cast<double>(counts[b]) * (static_cast<double>(to) - v) / static_cast<double>(to - from);
+
+        return ret / static_cast<double>(n);
+    } // <-- tailFraction()
+
+    void save(BinaryWriter& w) const {
+        w.write(lowest);
+        w.write(highest);
+        w.write(subBits);
+        w.write(counts);
+        w.write(underflow);
+        w.write(overflow);
+        w.write(minValue);
+        w.write(maxValue);
+    } // <-- save()
+
+    static HdrHistogram load(BinaryReader& r) {
+        HdrHistogram ret;
+        ret.lowest = r.read<double>();
+        ret.highest = r.read<double>();
+        ret.subBits = r.read<unsigned>();
+        ret.counts = r.readVector<std::uint64_t, BulkAllocator<std::uint64_t>>();
+        ret.underflow = r.read<std::uint64_t>();
+        ret.overflow = r.read<std::uint64_t>();
+        ret.minValue = r.read<double>();
+        ret.maxValue = r.read<double>();
+
+        if (
+            !(ret.lowest > 0 && ret.highest > ret.lowest) || ret.subBits == 0 || ret.subBits > 32
+            || ret.highest / ret.lowest >= 0x1.0p63
+            || ret.counts.size() != ret.bucketOf(static_cast<std::uint64_t>(ret.highest / ret.lowest)) + 1
+        ) {
+            throw std::runtime_error("Corrupted serialized HdrHistogram");
+        }
+        return ret;
+    } // <-- load()
+}; // <-- class HdrHistogram
+
+} // <-- namespace edu28
@@ -0,0 +1,195 @@
+#pragma once
+
+// Standard library
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <numeric>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "alloc.hh"
+#include "backend.hh"
+#include "base.hh"
+#include "serial.hh"
+
+namespace edu28 {
+
+/**
+ * \brief Performance of one bulk run
+ *
+ * Collected with two clock reads and one short lock per chunk, so it's free
+ * compared to the rolls
+ */
+struct RunMetrics {
+    /// \brief Number of rolls performed
+    std::uint64_t rolls = 0;
+    /// \brief Wall time of the whole run
+    double wallSeconds = 0;
+    /**
+     * \brief Time every thread spent on this run's chunks
+     *
+     * One entry per thread the backend could have run the chunks on: the
+     * submitting thread plus the pool workers for \ref Backend::Threads, up
+     * to the OpenMP thread limit for \ref Backend::OpenMP, up to the hardware
+     * concurrency for \ref Backend::StdPar, and never more than the chunks.
+     * Threads that ran chunks come first, in order of their first chunk, with
+     * the total of their chunks. The entries left over stand for threads that
+     * were busy elsewhere and count as idle (0). Work a thread did for other
+     * runs isn't included
+     */
+    std::vector<double> busySeconds;
+    /// \brief Time every chunk took, one entry per chunk
+    std::vector<double> chunkSeconds;
+    /// \brief Size of the returned results
+    std::uint64_t peakBytes = 0;
+
+    /// \brief Throughput
+    double rollsPerSecond() const {
+        return (wallSeconds > 0) ? static_cast<double>(rolls) / wallSeconds : 0;
+    } // <-- rollsPerSecond()
+
+    /// \brief Mean thread busy time
+    double meanBusySeconds() const {
+        if (busySeconds.empty()) return 0;
+        return std::accumulate(busySeconds.begin(), busySeconds.end(), 0.0) / static_cast<double>(busySeconds.size());
+    } // <-- meanBusySeconds()
+
+    /// \brief Load imbalance: longest thread busy time over the mean one, 1 is perfect
+    double imbalance() const {
+        const auto mean = meanBusySeconds();
+        if (mean <= 0) return 1;
+        return *std::max_element(busySeconds.begin(), busySeconds.end()) / mean;
+    } // <-- imbalance()
+
+    void save(BinaryWriter& w) const {
+        w.write(rolls);
+        w.write(wallSeconds);
+        w.write(busySeconds);
+        w.write(chunkSeconds);
+        w.write(peakBytes);
+    } // <-- save()
+
+    static RunMetrics load(BinaryReader& r) {
+        RunMetrics ret;
+        ret.rolls = r.read<std::uint64_t>();
+        ret.wallSeconds = r.read<double>();
+        ret.busySeconds = r.readVector<double>();
+        ret.chunkSeconds = r.readVector<double>();
+        ret.peakBytes = r.read<std::uint64_t>();
+        return ret;
+    } // <-- load()
+}; // <-- struct RunMetrics
+
+/**
+ * \brief Bulk run results with the \ref RunMetrics of the run that produced them
+ *
+ * Is a \ref BulkVector, so code that only needs the results doesn't change.
+ * `BulkResult<T>(n)` leaves trivial results uninitialized for the workers
+ * to fill
+ */
+template <typename T>
+struct BulkResult : BulkVector<T> {
+    /// \brief Performance of the run
+    RunMetrics metrics;
+
+    using BulkVector<T>::vector;
+
+    void save(BinaryWriter& w) const {
+        w.write(static_cast<const BulkVector<T>&>(*this));
+        metrics.save(w);
+    } // <-- save()
+
+    static BulkResult load(BinaryReader& r) {
+        BulkResult ret;
+        static_cast<BulkVector<T>&>(ret) = r.readVector<T, BulkAllocator<T>>();
+        ret.metrics = RunMetrics::load(r);
+        return ret;
+    } // <-- load()
+}; // <-- struct BulkResult
+
+/// \brief Implementation detail namespace
+namespace detail {
+
+    /**
+     * \brief Time `run(body)`, where `run` splits `rolls` rolls into `chunks`
+     *        chunks and calls `body(chunk, begin, end)` for each one on at
+     *        most `capacity` threads
+     */
+    template <typename Run, typename Func>
+    RunMetrics meteredRun(std::size_t rolls, std::size_t chunks, std::size_t capacity, Run&& run, Func&& func) {
+        using Clock = std::chrono::steady_clock;
+
+        RunMetrics ret;
+        ret.rolls = rolls;
+        ret.chunkSeconds.resize(chunks, 0);
+
+        // A chunk runs on one thread, so there are at most `chunks` of them
+        std::mutex mutex;
+        std::vector<std::pair<std::thread::id, double>> threads;
+        threads.reserve(chunks);
+
+        const auto start = Clock::now();
+        run(
+            [&ret, &func, &mutex, &threads] (std::size_t chunk, std::size_t begin, std::size_t end) {
+                const auto chunkStart = Clock::now();
+                func(chunk, begin, end);
+                const auto seconds = std::chrono::duration<double>(Clock::now() - chunkStart).count();
+                ret.chunkSeconds[chunk] = seconds;
+
+                const auto id = std::this_thread::get_id();
+                std::lock_guard lock(mutex);
+                const auto it = std::find_if(threads.begin(), threads.end(), [id] (const auto& t) { return t.first == id; });
+                if (it != threads.end()) {
+                    it->second += seconds;
+                } else {
+                    threads.emplace_back(id, seconds);
+                }
+            }
+        );
+        ret.wallSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        ret.busySeconds.resize(std::max(capacity, threads.size()), 0);
+        for (std::size_t i = 0; i < threads.size(); ++i) ret.busySeconds[i] = threads[i].second;
+
+        return ret;
+    } // <-- meteredRun()
+
+    /**
+     * \brief \ref parallelFor() over `rolls` rolls in `chunks` chunks that also
+     *        times the run, every chunk and every thread that ran one
+     */
+    template <typename Func>
+    RunMetrics meteredParallelFor(std::size_t rolls, std::size_t chunks, Func&& func) {
+        return meteredRun(
+            rolls, chunks, parallelThreads(chunks),
+            [rolls, chunks] (auto&& body) { parallelFor(rolls, chunks, body); },
+            std::forward<Func>(func)
+        );
+    } // <-- meteredParallelFor()
+
+    /**
+     * \brief \ref meteredParallelFor() with \ref getConcurrency() chunks
+     */
+    template <typename Func>
+    RunMetrics meteredParallelFor(std::size_t rolls, Func&& func) {
+        return meteredParallelFor(rolls, getConcurrency(), std::forward<Func>(func));
+    } // <-- meteredParallelFor()
+
+    /**
+     * \brief \ref meteredParallelFor() on `pool` instead of the selected backend
+     */
+    template <typename Func>
+    RunMetrics meteredParallelFor(ThreadPool& pool, std::size_t rolls, std::size_t chunks, Func&& func) {
+        return meteredRun(
+            rolls, chunks, std::min(chunks, pool.size() + 1),
+            [&pool, rolls, chunks] (auto&& body) { parallelFor(pool, rolls, chunks, body); },
+            std::forward<Func>(func)
+        );
+    } // <-- meteredParallelFor()
+
+} // <-- namespace detail
+
+} // <-- namespace edu28
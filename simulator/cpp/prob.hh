@@ -1,9 +1,16 @@
 #pragma once
 
+#include "backend.hh"
 #include "base.hh"
+#include "serial.hh"
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include <iostream>
 #include <random>
+#include <stdexcept>
+#include <string>
 
 namespace edu28 {
 
@@ -26,6 +33,72 @@ std::vector<Real> probNormalize(const std::vector<Real>& E, std::vector<Real> P)
     return P;
 } // <-- std::vector<Real> probNormalize()
 
+/**
+ * \brief Normalize a stack of probability distributions in place
+ *
+ * Rows are processed in parallel with the selected bulk backend. All
+ * integrals are computed and checked before any row is scaled, so `P` is
+ * left untouched if one of them can't be normalized
+ *
+ * \param E       - distribution grid. Either one row shared by all distributions
+ *                  or `rows` rows, row-major
+ * \param sharedE - whether `E` is a single shared row
+ * \param P       - `rows` x `cols` distributions, row-major. Normalized in place
+ * \param rows    - number of distributions
+ * \param cols    - grid size
+ *
+ * \return \int PdE of every row before normalization
+ *
+ * \throws std::runtime_error if there are rows but `cols < 2`, or a row's integral isn't positive
+ */
+std::vector<Real> probNormalizeBatch(
+    const Real* E, bool sharedE,
+    Real* P,
+    std::size_t rows, std::size_t cols
+) {
+    if (rows > 0 && cols < 2) throw std::runtime_error("probNormalizeBatch expects a grid of at least two points");
+
+    std::vector<Real> norms(rows, 0);
+
+    detail::parallelFor(
+        rows,
+        [E, sharedE, P, cols, &norms] (std::size_t, std::size_t start, std::size_t end) {
+            for (std::size_t row = start; row < end; ++row) {
+                const Real* e = sharedE ? E : E + row * cols;
+                const Real* p = P + row * cols;
+
+                Real pInt = 0;
+                #pragma omp simd reduction(+:pInt)
+                for (std::size_t i = 0; i < cols - 1; ++i) {
+                    pInt += (p[i] + p[i + 1]) * (e[i + 1] - e[i]);
+                }
+                norms[row] = pInt / 2;
+            }
+        }
+    );
+
+    for (std::size_t row = 0; row < rows; ++row) {
+        if (!(norms[row] > 0)) {
+            throw std::runtime_error("probNormalizeBatch: row " + std::to_string(row) + " has no positive probability mass");
+        }
+    }
+
+    detail::parallelFor(
+        rows,
+        [P, cols, &norms] (std::size_t, std::size_t start, std::size_t end) {
+            for (std::size_t row = start; row < end; ++row) {
+                Real* p = P + row * cols;
+
+                const Real inv = 1 / norms[row];
+                #pragma omp simd
+                for (std::size_t i = 0; i < cols; ++i) p[i] *= inv;
+            }
+        }
+    );
+
+    return norms;
+} // <-- std::vector<Real> probNormalizeBatch()
+
 /**
  * \brief Roll a value from uniform distribution in the interval [from, to]
  */
@@ -35,33 +108,463 @@ ValueType uniformRoll(ValueType from, ValueType to) {
     static thread_local std::random_device rd{};
     static thread_local std::mt19937 gen{rd()};
 
-    static thread_local std::uniform_real_distribution<Real> dist(from, to);
+    // The range is passed on every draw: pool workers and the calling thread
+    // outlive a single call, so a range fixed at construction would stick
+    static thread_local std::uniform_real_distribution<Real> dist{};
+    using Range = std::uniform_real_distribution<Real>::param_type;
 
-    return dist(gen);
+    return dist(gen, Range(from, to));
 } // <-- Real uniformRoll()
 
+/// \brief Implementation detail namespace
+namespace detail {
+
+    /**
+     * \brief The thread's \ref uniformRoll() engine for distributions that
+     *        draw from an RNG object, e.g. \ref OffsetDistribution
+     */
+    struct ThreadRng {
+        Real uniform() { return uniformRoll<Real>(0, 1); }
+        int uniformInt(int from, int to) { return uniformRoll(from, to + 1); }
+    }; // <-- struct ThreadRng
+
+} // <-- namespace detail
+
 /**
  * \brief Rolls a random value with a given probability distribution
  *
- * Assumes distribution defined by `P`, `E` is normalized
+ * Assumes distribution defined by `P`, `E` is normalized.
+ * Doesn't allocate
  */
 Real rollScalar(const std::vector<Real>& E, const std::vector<Real>& P) {
     const auto roll = uniformRoll<Real>(0, 1);
 
-    std::vector<Real> pInt(E.size(), 0);
+    // Running trapezoid sums up to `idx` and `idx + 1`
+    Real pIntPrev = 0;
+    Real pIntNext = 0;
 
     std::size_t idx = 0;
 
     while (idx + 1 < E.size()) {
-        pInt[idx + 1] = pInt[idx] + (P[idx + 1] + P[idx]) * (E[idx + 1] - E[idx]) / 2;
+        pIntNext = pIntPrev + (P[idx + 1] + P[idx]) * (E[idx + 1] - E[idx]) / 2;
 
-        if (pInt[idx + 1] >= roll) break;
+        if (pIntNext >= roll) break;
+        pIntPrev = pIntNext;
         ++idx;
     }
 
-    const auto t = (roll - pInt[idx]) / (pInt[idx + 1] - pInt[idx]);
+    // Only reachable if `P` integrates to less than the roll
+    if (idx + 1 >= E.size()) return E.back();
+
+    const auto t = (roll - pIntPrev) / (pIntNext - pIntPrev);
 
     return E[idx] + t * (E[idx + 1] - E[idx]);
 } // <-- Real rollScalar()
 
+/**
+ * \brief Walker's alias table for O(1) sampling of a discrete distribution
+ *
+ * Built with Vose's method
+ */
+class AliasTable {
+    std::vector<Real> prob;
+    std::vector<std::uint32_t> alias;
+
+public:
+    AliasTable() = default;
+
+    /**
+     * \brief Build the table
+     *
+     * \param weights - non-negative weights, don't have to be normalized
+     *
+     * \throws std::runtime_error if there are no weights, any is negative or NaN,
+     *         or they sum to zero
+     */
+    explicit AliasTable(const std::vector<Real>& weights) : prob(weights.size()), alias(weights.size()) {
+        const auto n = weights.size();
+
+        double total = 0;
+        for (auto w : weights) {
+            if (!(w >= 0)) throw std::runtime_error("AliasTable expects non-negative weights");
+            total += w;
+        }
+        if (n == 0 || !(total > 0)) throw std::runtime_error("AliasTable expects non-empty weights with a positive sum");
+
+        std::vector<double> scaled(n);
+        std::vector<std::uint32_t> small, large;
+        for (std::size_t i = 0; i < n; ++i) {
+            scaled[i] = weights[i] * static_cast<double>(n) / total;
+            (scaled[i] < 1 ? small : large).push_back(static_cast<std::uint32_t>(i));
+        }
+
+        while (!small.empty() && !large.empty()) {
+            const auto s = small.back(); small.pop_back();
+            const auto l = large.back(); large.pop_back();
+
+            prob[s] = static_cast<Real>(scaled[s]);
+            alias[s] = l;
+
+            scaled[l] -= 1 - scaled[s];
+            (scaled[l] < 1 ? small : large).push_back(l);
+        }
+
+        // Leftovers only differ from 1 by rounding
+        for (auto i : large) { prob[i] = 1; alias[i] = i; }
+        for (auto i : small) { prob[i] = 1; alias[i] = i; }
+    } // <-- AliasTable()
+
+    /// \brief Number of outcomes
+    std::size_t size() const { return prob.size(); }
+
+    /// \brief Roll an outcome index
+    template <typename Rng>
+    std::size_t operator()(Rng& rng) const {
+        const auto u = rng.uniform() * static_cast<Real>(prob.size());
+        const auto i = std::min(static_cast<std::size_t>(u), prob.size() - 1);
+        return (u - static_cast<Real>(i) < prob[i]) ? i : alias[i];
+    } // <-- operator()
+
+    void save(BinaryWriter& w) const {
+        w.write(prob);
+        w.write(alias);
+    } // <-- save()
+
+    static AliasTable load(BinaryReader& r) {
+        AliasTable ret;
+        ret.prob = r.readVector<Real>();
+        ret.alias = r.readVector<std::uint32_t>();
+        if (ret.prob.size() != ret.alias.size()) throw std::runtime_error("Corrupted serialized AliasTable");
+        return ret;
+    } // <-- load()
+}; // <-- class AliasTable
+
+/**
+ * \brief Distribution of the second signal's integer peak offset
+ *
+ * Offsets in [min, max] are drawn from an \ref AliasTable over their
+ * probabilities in O(1), whatever the shape of the distribution. The
+ * uniform distribution draws with `uniformInt()` instead, which keeps the
+ * roll streams of earlier versions.
+ */
+class OffsetDistribution {
+    int offsetMin = 0;
+    int offsetMax = 0;
+    std::vector<Real> pmf;
+    AliasTable table;
+    bool uniform = true;
+
+public:
+    OffsetDistribution() = default;
+
+    /**
+     * \brief Offsets in [offsetMin, offsetMax] with probabilities `weights`
+     *
+     * \param weights - one non-negative weight per offset, don't have to be normalized
+     *
+     * \throws std::runtime_error if there are no weights, any is negative or NaN,
+     *         or they sum to zero
+     */
+    OffsetDistribution(int offsetMin, const std::vector<Real>& weights)
+        : offsetMin(offsetMin), offsetMax(offsetMin + static_cast<int>(weights.size()) - 1),
+          pmf(weights), uniform(false)
+    {
+        if (weights.empty()) throw std::runtime_error("OffsetDistribution expects at least one offset weight");
+        table = AliasTable(weights);
+
+        Real total = 0;
+        for (auto w : pmf) total += w;
+        for (auto& p : pmf) p /= total;
+    } // <-- OffsetDistribution()
+
+    /**
+     * \brief Equally likely offsets in [offsetMin, offsetMax]
+     *
+     * \throws std::runtime_error if `offsetMax < offsetMin`
+     */
+    static OffsetDistribution uniformRange(int offsetMin, int offsetMax) {
+        if (offsetMax < offsetMin) throw std::runtime_error("OffsetDistribution expects offsetMin <= offsetMax");
+
+        OffsetDistribution ret(offsetMin, std::vector<Real>(offsetMax - offsetMin + 1, 1));
+        ret.uniform = true;
+        return ret;
+    } // <-- uniformRange()
+
+    /**
+     * \brief Exponential arrival gaps of a Poisson process of `rate` events per
+     *        grid unit with a non-extending dead time, restricted to [offsetMin, offsetMax]
+     *
+     * A continuous gap `t` lands on the nearest offset, so offset `o` gets the
+     * probability of `t` in `[o - 0.5, o + 0.5)`. Gaps shorter than `deadTime`
+     * aren't registered
+     *
+     * \throws std::runtime_error if `rate` isn't positive or no offset is reachable
+     */
+    static OffsetDistribution exponential(int offsetMin, int offsetMax, double rate, double deadTime = 0) {
+        if (offsetMax < offsetMin || !(rate > 0)) {
+            throw std::runtime_error("OffsetDistribution expects offsetMin <= offsetMax and a positive rate");
+        }
+        if (!(deadTime < offsetMax + 0.5)) {
+            throw std::runtime_error("OffsetDistribution dead time is longer than every offset");
+        }
+
+        std::vector<Real> weights(offsetMax - offsetMin + 1);
+        for (int o = offsetMin; o <= offsetMax; ++o) {
+            const auto from = std::max(o - 0.5, deadTime);
+            const auto to = o + 0.5;
+            // exp(-rate * from) - exp(-rate * to), scaled by exp(rate * deadTime) to stay in range
+            weights[o - offsetMin] = (to > from)
+                ? static_cast<Real>(std::exp(-rate * (from - deadTime)) * -std::expm1(-rate * (to - from)))
+                : 0;
+        }
+
+        return OffsetDistribution(offsetMin, weights);
+    } // <-- exponential()
+
+    /// \brief Smallest offset
+    int min() const { return offsetMin; }
+    /// \brief Largest offset
+    int max() const { return offsetMax; }
+    /// \brief Normalized probability of every offset in [min, max]
+    const std::vector<Real>& probabilities() const { return pmf; }
+    /// \brief Whether offsets are equally likely
+    bool isUniform() const { return uniform; }
+
+    /// \brief Probability of `offset`
+    Real probability(int offset) const {
+        return (offset < offsetMin || offset > offsetMax) ? 0 : pmf[offset - offsetMin];
+    } // <-- probability()
+
+    /// \brief Roll an offset using the given RNG
+    template <typename Rng>
+    int operator()(Rng& rng) const {
+        if (uniform) return rng.uniformInt(offsetMin, offsetMax);
+        return offsetMin + static_cast<int>(table(rng));
+    } // <-- operator()
+
+    void save(BinaryWriter& w) const {
+        w.write(offsetMin);
+        w.write(pmf);
+        w.write(uniform);
+    } // <-- save()
+
+    static OffsetDistribution load(BinaryReader& r) {
+        const auto offsetMin = r.read<int>();
+        const auto pmf = r.readVector<Real>();
+        const auto uniform = r.read<bool>();
+
+        OffsetDistribution ret(offsetMin, pmf);
+        ret.uniform = uniform;
+        return ret;
+    } // <-- load()
+}; // <-- class OffsetDistribution
+
+/**
+ * \brief Amplitude distribution with precomputed sampling tables
+ *
+ * Same distribution as \ref rollScalar(): the density is trapezoid-integrated
+ * over grid intervals, and values are uniform inside an interval.
+ * The cumulative sums are kept for \ref quantile(), while draws pick the
+ * interval from an \ref AliasTable in O(1).
+ * `P` doesn't have to be normalized.
+ */
+class Distribution {
+    std::vector<Real> E;
+    std::vector<Real> cdf;
+    AliasTable intervals;
+
+    void buildIntervals() {
+        std::vector<Real> mass(cdf.size() - 1);
+        for (std::size_t i = 0; i < mass.size(); ++i) mass[i] = cdf[i + 1] - cdf[i];
+        intervals = AliasTable(mass);
+    } // <-- buildIntervals()
+
+public:
+    Distribution() = default;
+
+    /**
+     * \brief Build the CDF table
+     *
+     * \throws std::runtime_error if `E` and `P` sizes differ, the grid has
+     *         less than two points or the distribution has no mass
+     */
+    Distribution(std::vector<Real> E, const std::vector<Real>& P) : E(std::move(E)) {
+        if (this->E.size() != P.size() || this->E.size() < 2) {
+            throw std::runtime_error("Distribution expects `E` and `P` of the same size of at least 2");
+        }
+
+        cdf.resize(this->E.size(), 0);
+        for (std::size_t i = 0; i + 1 < this->E.size(); ++i) {
+            cdf[i + 1] = cdf[i] + (P[i + 1] + P[i]) * (this->E[i + 1] - this->E[i]) / 2;
+        }
+
+        const auto total = cdf.back();
+        if (!(total > 0)) throw std::runtime_error("Distribution expects a non-zero total probability");
+        for (auto& c : cdf) c /= total;
+
+        buildIntervals();
+    } // <-- Distribution()
+
+    /// \brief Distribution grid
+    const std::vector<Real>& grid() const { return E; }
+    /// \brief Normalized CDF at grid points
+    const std::vector<Real>& cdfTable() const { return cdf; }
+
+    /// \brief Smallest value the distribution can produce
+    Real min() const { return E.front(); }
+    /// \brief Largest value the distribution can produce
+    Real max() const { return E.back(); }
+
+    /**
+     * \brief Inverse CDF
+     *
+     * \param u - probability in [0, 1]
+     */
+    Real quantile(Real u) const {
+        const auto it = std::upper_bound(cdf.begin() + 1, cdf.end(), u);
+        const std::size_t idx = std::min<std::size_t>(it - cdf.begin() - 1, cdf.size() - 2);
+
+        const auto dc = cdf[idx + 1] - cdf[idx];
+        const auto t = (dc > 0) ? (u - cdf[idx]) / dc : Real{ 0 };
+
+        return E[idx] + t * (E[idx + 1] - E[idx]);
+    } // <-- Real quantile()
+
+    /// \brief Probability of a draw not exceeding `x`
+    Real cdfAt(Real x) const {
+        if (x <= E.front()) return 0;
+        if (x >= E.back()) return 1;
+
+        const auto idx = static_cast<std::size_t>(std::upper_bound(E.begin(), E.end(), x) - E.begin()) - 1;
+        const auto t = (x - E[idx]) / (E[idx + 1] - E[idx]);
+        return cdf[idx] + t * (cdf[idx + 1] - cdf[idx]);
+    } // <-- cdfAt()
+
+    /// \brief Roll a value using the given RNG
+    template <typename Rng>
+    Real operator()(Rng& rng) const {
+        const auto idx = intervals(rng);
+        return E[idx] + rng.uniform() * (E[idx + 1] - E[idx]);
+    } // <-- operator()
+
+    void save(BinaryWriter& w) const {
+        w.write(E);
+        w.write(cdf);
+    } // <-- save()
+
+    static Distribution load(BinaryReader& r) {
+        Distribution ret;
+        ret.E = r.readVector<Real>();
+        ret.cdf = r.readVector<Real>();
+        if (ret.E.size() != ret.cdf.size() || ret.E.size() < 2) {
+            throw std::runtime_error("Corrupted serialized Distribution");
+        }
+        ret.buildIntervals();
+        return ret;
+    } // <-- load()
+}; // <-- class Distribution
+
+/**
+ * \brief Weighted mixture of amplitude distributions
+ *
+ * A draw picks a component from an \ref AliasTable over the weights and then
+ * draws from it, so the cost stays O(1) regardless of the number of
+ * components. A single distribution is a mixture of one.
+ */
+class MixtureDistribution {
+    std::vector<Distribution> components;
+    std::vector<Real> weights;
+    AliasTable picker;
+
+public:
+    MixtureDistribution() = default;
+
+    /// \brief Mixture of a single distribution
+    MixtureDistribution(Distribution distribution)
+        : MixtureDistribution(std::vector{ std::move(distribution) }, { 1 })
+    {}
+
+    /**
+     * \throws std::runtime_error if the number of components and weights differ
+     *         or there are no components
+     */
+    MixtureDistribution(std::vector<Distribution> components, std::vector<Real> weights)
+        : components(std::move(components)), weights(std::move(weights))
+    {
+        if (this->components.size() != this->weights.size()) {
+            throw std::runtime_error("MixtureDistribution expects one weight per component");
+        }
+        picker = AliasTable(this->weights);
+    } // <-- MixtureDistribution()
+
+    /// \brief Mixture components
+    const std::vector<Distribution>& getComponents() const { return components; }
+    /// \brief Component weights as given
+    const std::vector<Real>& getWeights() const { return weights; }
+
+    /// \brief Smallest value the mixture can produce
+    Real min() const {
+        Real ret = components.front().min();
+        for (const auto& c : components) ret = std::min(ret, c.min());
+        return ret;
+    } // <-- min()
+
+    /// \brief Largest value the mixture can produce
+    Real max() const {
+        Real ret = components.front().max();
+        for (const auto& c : components) ret = std::max(ret, c.max());
+        return ret;
+    } // <-- max()
+
+    /// \brief Probability of a draw not exceeding `x`
+    Real cdfAt(Real x) const {
+        Real ret = 0, total = 0;
+        for (std::size_t i = 0; i < components.size(); ++i) {
+            ret += weights[i] * components[i].cdfAt(x);
+            total += weights[i];
+        }
+        return ret / total;
+    } // <-- cdfAt()
+
+    /**
+     * \brief Inverse CDF
+     *
+     * Delegates to the component for a single distribution, bisects
+     * \ref cdfAt() otherwise
+     *
+     * \param u - probability in [0, 1]
+     */
+    Real quantile(Real u) const {
+        if (components.size() == 1) return components.front().quantile(u);
+
+        Real lo = min(), hi = max();
+        for (int i = 0; i < 64 && lo < hi; ++i) {
+            const auto mid = lo + (hi - lo) / 2;
+            if (mid <= lo || mid >= hi) break;
+            (cdfAt(mid) < u ? lo : hi) = mid;
+        }
+        return hi;
+    } // <-- quantile()
+
+    /// \brief Roll a value using the given RNG
+    template <typename Rng>
+    Real operator()(Rng& rng) const {
+        if (components.size() == 1) return components.front()(rng);
+        return components[picker(rng)](rng);
+    } // <-- operator()
+
+    void save(BinaryWriter& w) const {
+        w.write<std::uint64_t>(components.size());
+        for (const auto& c : components) c.save(w);
+        w.write(weights);
+    } // <-- save()
+
+    static MixtureDistribution load(BinaryReader& r) {
+        std::vector<Distribution> components(r.read<std::uint64_t>());
+        for (auto& c : components) c = Distribution::load(r);
+        auto weights = r.readVector<Real>();
+        return MixtureDistribution(std::move(components), std::move(weights));
+    } // <-- load()
+}; // <-- class MixtureDistribution
+
 } // <-- namespace edu28
@@ -0,0 +1,167 @@
+#pragma once
+
+// Standard library
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include <utility>
+
+#include "base.hh"
+
+namespace edu28 {
+
+/**
+ * \brief Bounded lock-free multi-producer multi-consumer queue
+ *
+ * Ring buffer with per-cell sequence numbers (D. Vyukov's MPMC queue).
+ * Capacity is rounded up to a power of two.
+ *
+ * Blocking \ref push() and \ref pop() spin with backoff instead of waiting on
+ * a mutex: a full queue throttles producers (backpressure), an empty one
+ * stalls consumers. After \ref close() producers are rejected and consumers
+ * drain whatever is left.
+ */
+template <typename T>
+class MPMCQueue {
+    struct Cell {
+        std::atomic<std::size_t> sequence;
+        T data;
+    };
+
+    std::unique_ptr<Cell[]> buffer;
+    std::size_t mask;
+
+    alignas(64) std::atomic<std::size_t> enqueuePos{ 0 };
+    alignas(64) std::atomic<std::size_t> dequeuePos{ 0 };
+    alignas(64) std::atomic<bool> closed{ false };
+
+    /// \brief Wait a little longer on every failed attempt
+    static void backoff(unsigned& attempt) {
+        if (attempt < 64) {
+            // busy spin
+        } else if (attempt < 256) {
+            std::this_thread::yield();
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+        ++attempt;
+    } // <-- backoff()
+
+public:
+    /**
+     * \brief Create a queue
+     *
+     * \param capacity - minimum number of elements the queue holds before
+     *                   producers get throttled
+     */
+    explicit MPMCQueue(std::size_t capacity) {
+        std::size_t size = 2;
+        while (size < capacity) size <<= 1;
+
+        buffer = std::make_unique<Cell[]>(size);
+        mask = size - 1;
+
+        for (std::size_t i = 0; i < size; ++i) {
+            buffer[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    } // <-- MPMCQueue()
+
+    MPMCQueue(const MPMCQueue&) = delete;
+    MPMCQueue& operator=(const MPMCQueue&) = delete;
+
+    /// \brief Queue capacity
+    std::size_t capacity() const { return mask + 1; }
+
+    /**
+     * \brief Try to enqueue a value without waiting
+     *
+     * \return `false` if the queue is full. `value` is left untouched then
+     */
+    bool tryPush(T& value) {
+        std::size_t pos = enqueuePos.load(std::memory_order_relaxed);
+
+        for (;;) {
+            Cell& cell = buffer[pos & mask];
+            const std::size_t seq = cell.sequence.load(std::memory_order_acquire);
+            const auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+
+            if (diff == 0) {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.data = std::move(value);
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+    } // <-- tryPush()
+
+    /**
+     * \brief Try to dequeue a value without waiting
+     *
+     * \return `false` if the queue is empty
+     */
+    bool tryPop(T& value) {
+        std::size_t pos = dequeuePos.load(std::memory_order_relaxed);
+
+        for (;;) {
+            Cell& cell = buffer[pos & mask];
+            const std::size_t seq = cell.sequence.load(std::memory_order_acquire);
+            const auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos + 1);
+
+            if (diff == 0) {
+                if (dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    value = std::move(cell.data);
+                    cell.sequence.store(pos + mask + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = dequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+    } // <-- tryPop()
+
+    /**
+     * \brief Enqueue a value, waiting while the queue is full
+     *
+     * \return `false` if the queue was closed before the value could be enqueued
+     */
+    bool push(T value) {
+        unsigned attempt = 0;
+        while (!closed.load(std::memory_order_acquire)) {
+            if (tryPush(value)) return true;
+            backoff(attempt);
+        }
+        return false;
+    } // <-- push()
+
+    /**
+     * \brief Dequeue a value, waiting while the queue is empty
+     *
+     * \return `false` if the queue is closed and drained
+     */
+    bool pop(T& value) {
+        unsigned attempt = 0;
+        for (;;) {
+            if (tryPop(value)) return true;
+            // Re-check after observing `closed` so that late pushes aren't lost
+            if (closed.load(std::memory_order_acquire)) return tryPop(value);
+            backoff(attempt);
+        }
+    } // <-- pop()
+
+    /// \brief Stop accepting new values. Consumers may still drain the queue
+    void close() { closed.store(true, std::memory_order_release); }
+
+    /// \brief Was the queue closed?
+    bool isClosed() const { return closed.load(std::memory_order_acquire); }
+}; // <-- class MPMCQueue
+
+} // <-- namespace edu28
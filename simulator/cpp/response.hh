@@ -0,0 +1,434 @@
+#pragma once
+
+// Standard library
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "backend.hh"
+#include "base.hh"
+#include "budget.hh"
+#include "context.hh"
+#include "hist.hh"
+#include "prob.hh"
+#include "serial.hh"
+
+namespace edu28 {
+
+/**
+ * \brief Linear and bilinear maps from an amplitude spectrum to a spectrum
+ *        of integrals
+ *
+ * Amplitude grid point `i` stands for the cell between the midpoints to its
+ * neighbours (the end cells are extended by half an interval), and the
+ * input is the probability of every cell, see \ref probabilitiesOf(). The
+ * output is the probability of every bin of an integral \ref Binning.
+ *
+ * - Singles are the mass of a cell spread uniformly over its image
+ *   `singleCoef * cell`: a sparse matrix, stored by column.
+ * - A double of grid points `(a1, a2)` with a given offset has the integral
+ *   `singleCoef * E[a1] + offsetCoef[offset] * E[a2]`. Its mass is split
+ *   linearly between the two nearest bin centres, so every `(offset, a1, a2)`
+ *   is one bin index and one weight.
+ *
+ * Mass landing outside of the binning is lost, so the outputs sum to less
+ * than one where the binning doesn't cover every integral.
+ *
+ * The tables only depend on the signal shape, the window, the offset
+ * distribution and the two grids, so one operator serves every spectrum of
+ * an HV scan measured on the same grid. \ref applyAll() evaluates many
+ * spectra at once, reading the tables once per \ref block spectra.
+ */
+class ResponseOperator {
+public:
+    /// \brief Spectra per block of \ref applyAll()
+    static constexpr std::size_t block = 8;
+
+private:
+    /// \brief Bin index marking a double that lands outside of the binning
+    static constexpr std::uint32_t outside = std::numeric_limits<std::uint32_t>::max();
+
+    std::vector<Real> E;
+    /// \brief Cell boundaries, one more than grid points
+    std::vector<double> cellEdges;
+    Binning binning;
+
+    /// \brief Singles matrix column `i` is `singleRows/singleWeights[singleStart[i]..singleStart[i + 1])`
+    std::vector<std::uint32_t> singleStart;
+    std::vector<std::uint32_t> singleRows;
+    std::vector<float> singleWeights;
+
+    /// \brief Probability of every tabulated offset
+    std::vector<Real> offsetProbabilities;
+    /// \brief Lower bin of every double for every offset, `a1`, `a2` (`a2` fastest)
+    std::vector<std::uint32_t> lower;
+    /// \brief Weight of the bin above, same layout
+    std::vector<float> upper;
+
+    std::size_t size() const { return E.size(); }
+
+    /// \brief Lower bin and upper bin weight of a point mass at integral `y`
+    std::pair<std::uint32_t, float> place(double y, const std::vector<double>& centres) const {
+        const auto bins = centres.size();
+        const auto bin = binning.find(y);
+        if (bin == Binning::npos) return { outside, 0.0f };
+
+        // Beyond the outer centres the mass stays in the end bins
+        if (y <= centres.front()) return { 0, 0.0f };
+        if (y >= centres.back()) return { static_cast<std::uint32_t>(bins - 1), 0.0f };
+
+        const auto j = (y < centres[bin]) ? bin - 1 : bin;
+        return {
+            static_cast<std::uint32_t>(j),
+            static_cast<float>((y - centres[j]) / (centres[j + 1] - centres[j]))
+        };
+    } // <-- place()
+
+public:
+    ResponseOperator() = default;
+
+    /**
+     * \brief Tabulate the singles matrix and the doubles kernel
+     *
+     * \param setup   - shape, window and offset distribution. Its amplitudes are unused
+     * \param E       - amplitude grid, ascending
+     * \param binning - integral bins
+     *
+     * \throws std::runtime_error if the grid has less than two points or isn't
+     *         ascending, or the setup's single signal coefficient isn't positive
+     * \throws MemoryBudgetExceeded if the tables don't fit into the memory budget
+     */
+    ResponseOperator(const SimulationContext& setup, std::vector<Real> E, Binning binning)
+        : E(std::move(E)), binning(std::move(binning))
+    {
+        const auto n = size();
+        if (n < 2 || std::adjacent_find(this->E.begin(), this->E.end(), std::greater_equal<Real>{}) != this->E.end()) {
+            throw std::runtime_error("ResponseOperator expects an ascending grid of at least two points");
+        }
+        const double s = setup.getSingleCoef();
+        if (!(s > 0)) throw std::runtime_error("ResponseOperator expects a window that contains the signal");
+
+        cellEdges.resize(n + 1);
+        cellEdges[0] = this->E[0] - (this->E[1] - this->E[0]) / 2.0;
+        for (std::size_t i = 1; i < n; ++i) cellEdges[i] = (this->E[i - 1] + this->E[i]) / 2.0;
+        cellEdges[n] = this->E[n - 1] + (this->E[n - 1] - this->E[n - 2]) / 2.0;
+
+        const auto bins = this->binning.bins();
+        const auto edges = this->binning.edges();
+        std::vector<double> centres(bins);
+        for (std::size_t b = 0; b < bins; ++b) centres[b] = (edges[b] + edges[b + 1]) / 2;
+
+        const auto& pmf = setup.getOffsets().probabilities();
+        const auto& coefs = setup.getOffsetCoef();
+        const auto tabulated = static_cast<std::uint64_t>(std::count_if(pmf.begin(), pmf.end(), [] (Real p) { return p > 0; }));
+        detail::checkMemoryBudget(
+            tabulated * n * n * (sizeof(std::uint32_t) + sizeof(float)),
+            "ResponseOperator tables for " + std::to_string(n) + " grid points"
+        );
+
+        // Singles: overlap of the cell image with every bin it touches
+        singleStart.push_back(0);
+        for (std::size_t i = 0; i < n; ++i) {
+            const auto from = s * cellEdges[i];
+            const auto to = s * cellEdges[i + 1];
+            const auto first = std::upper_bound(edges.begin(), edges.end(), from) - edges.begin();
+
+            for (auto b = std::max<std::ptrdiff_t>(first - 1, 0); b < static_cast<std::ptrdiff_t>(bins); ++b) {
+                if (edges[b] >= to) break;
+                const auto overlap = std::min(to, edges[b + 1]) - std::max(from, edges[b]);
+                if (overlap <= 0) continue;
+
+                singleRows.push_back(static_cast<std::uint32_t>(b));
+                singleWeights.push_back(static_cast<float>(overlap / (to - from)));
+            }
+            singleStart.push_back(static_cast<std::uint32_t>(singleRows.size()));
+        }
+
+        lower.reserve(tabulated * n * n);
+        upper.reserve(tabulated * n * n);
+        for (std::size_t o = 0; o < coefs.size(); ++o) {
+            if (pmf[o] <= 0) continue;
+            offsetProbabilities.push_back(pmf[o]);
+
+            for (std::size_t a1 = 0; a1 < n; ++a1) {
+                for (std::size_t a2 = 0; a2 < n; ++a2) {
+                    const auto [j, w] = place(s * this->E[a1] + static_cast<double>(coefs[o]) * this->E[a2], centres);
+                    lower.push_back(j);
+                    upper.push_back(w);
+                }
+            }
+        }
+    } // <-- ResponseOperator()
+
+    /// \brief Amplitude grid
+    const std::vector<Real>& grid() const { return E; }
+    /// \brief Amplitude cell boundaries
+    const std::vector<double>& cells() const { return cellEdges; }
+    /// \brief Integral bins
+    const Binning& getBinning() const { return binning; }
+
+    /**
+     * \brief Probability of every amplitude cell under `amplitudes`
+     */
+    std::vector<double> probabilitiesOf(const Distribution& amplitudes) const {
+        std::vector<double> ret(size());
+        for (std::size_t i = 0; i < size(); ++i) {
+            ret[i] = amplitudes.cdfAt(static_cast<Real>(cellEdges[i + 1])) - amplitudes.cdfAt(static_cast<Real>(cellEdges[i]));
+        }
+        return ret;
+    } // <-- probabilitiesOf()
+
+    /**
+     * \brief Bin probabilities of single events with cell probabilities `f`
+     *
+     * \throws std::runtime_error if `f` isn't on the grid
+     */
+    std::vector<double> singles(const std::vector<double>& f) const {
+        if (f.size() != size()) throw std::runtime_error("ResponseOperator expects probabilities on its grid");
+
+        std::vector<double> ret(binning.bins(), 0);
+        for (std::size_t i = 0; i < size(); ++i) {
+            for (auto k = singleStart[i]; k < singleStart[i + 1]; ++k) ret[singleRows[k]] += singleWeights[k] * f[i];
+        }
+        return ret;
+    } // <-- singles()
+
+    /**
+     * \brief Bin probabilities of double events with cell probabilities `f`
+     *
+     * \throws std::runtime_error if `f` isn't on the grid
+     */
+    std::vector<double> doubles(const std::vector<double>& f) const {
+        const auto n = size();
+        if (f.size() != n) throw std::runtime_error("ResponseOperator expects probabilities on its grid");
+
+        std::vector<double> ret(binning.bins(), 0);
+        for (std::size_t o = 0; o < offsetProbabilities.size(); ++o) {
+            const auto* lo = lower.data() + o * n * n;
+            const auto* up = upper.data() + o * n * n;
+            const double po = offsetProbabilities[o];
+
+            for (std::size_t a1 = 0; a1 < n; ++a1) {
+                if (f[a1] == 0) continue;
+                const auto w1 = po * f[a1];
+
+                for (std::size_t a2 = 0; a2 < n; ++a2) {
+                    const auto k = a1 * n + a2;
+                    if (lo[k] == outside) continue;
+
+                    const auto w = w1 * f[a2];
+                    ret[lo[k]] += w * (1 - up[k]);
+                    if (up[k] != 0) ret[lo[k] + 1] += w * up[k];
+                }
+            }
+        }
+        return ret;
+    } // <-- doubles()
+
+    /**
+     * \brief Bin probabilities of all events, a fraction `pileup` of them double
+     */
+    std::vector<double> apply(const std::vector<double>& f, double pileup) const {
+        auto ret = singles(f);
+        const auto d = doubles(f);
+        for (std::size_t b = 0; b < ret.size(); ++b) ret[b] = (1 - pileup) * ret[b] + pileup * d[b];
+        return ret;
+    } // <-- apply()
+
+    /**
+     * \brief Transposed Jacobian of \ref apply() at `f` times `q` and times ones
+     *
+     * \param back        - output, `J^T q`
+     * \param sensitivity - output, `J^T 1`: probability that an event involving
+     *                      a cell lands in the binning
+     */
+    void backProject(
+        const std::vector<double>& f, const std::vector<double>& q, double pileup,
+        std::vector<double>& back, std::vector<double>& sensitivity
+    ) const {
+        const auto n = size();
+        if (f.size() != n || q.size() != binning.bins()) {
+            throw std::runtime_error("ResponseOperator expects probabilities on its grid and values on its bins");
+        }
+
+        back.assign(n, 0);
+        sensitivity.assign(n, 0);
+        for (std::size_t i = 0; i < n; ++i) {
+            for (auto k = singleStart[i]; k < singleStart[i + 1]; ++k) {
+                back[i] += (1 - pileup) * singleWeights[k] * q[singleRows[k]];
+                sensitivity[i] += (1 - pileup) * singleWeights[k];
+            }
+        }
+
+        // A double of `(a1, a2)` depends on both amplitudes
+        for (std::size_t o = 0; o < offsetProbabilities.size(); ++o) {
+            const auto* lo = lower.data() + o * n * n;
+            const auto* up = upper.data() + o * n * n;
+            const auto wo = pileup * offsetProbabilities[o];
+
+            for (std::size_t a1 = 0; a1 < n; ++a1) {
+                double back1 = 0, sens1 = 0;
+                for (std::size_t a2 = 0; a2 < n; ++a2) {
+                    const auto k = a1 * n + a2;
+                    if (lo[k] == outside) continue;
+
+                    const auto qy = (up[k] != 0) ? q[lo[k]] * (1 - up[k]) + q[lo[k] + 1] * up[k] : q[lo[k]];
+                    back1 += f[a2] * qy;
+                    sens1 += f[a2];
+                    back[a2] += wo * f[a1] * qy;
+                    sensitivity[a2] += wo * f[a1];
+                }
+                back[a1] += wo * back1;
+                sensitivity[a1] += wo * sens1;
+            }
+        }
+    } // <-- backProject()
+
+    /**
+     * \brief \ref apply() to many spectra, e.g. every HV point of a scan
+     *
+     * Spectra are processed in blocks of \ref block, one block per task.
+     * Within a block every table entry is read once and applied to all of
+     * its spectra in a fixed-width loop the compiler vectorizes.
+     *
+     * \param f      - cell probabilities of every spectrum
+     * \param pileup - fraction of double events, the same for every spectrum
+     *
+     * \throws std::runtime_error if a spectrum isn't on the grid
+     */
+    std::vector<std::vector<double>> applyAll(const std::vector<std::vector<double>>& f, double pileup) const {
+        const auto n = size();
+        const auto bins = binning.bins();
+        for (const auto& x : f) {
+            if (x.size() != n) throw std::runtime_error("ResponseOperator expects probabilities on its grid");
+        }
+
+        std::vector<std::vector<double>> ret(f.size(), std::vector<double>(bins));
+        const auto blocks = (f.size() + block - 1) / block;
+
+        detail::parallelFor(
+            blocks, blocks,
+            [&] (std::size_t, std::size_t start, std::size_t end) {
+                // Interleaved, spectrum index fastest. Missing spectra of the last block are zero
+                std::vector<std::array<double, block>> in(n), single(bins), pair(bins);
+
+                for (auto blk = start; blk < end; ++blk) {
+                    const auto first = blk * block;
+                    const auto width = std::min(block, f.size() - first);
+
+                    for (std::size_t i = 0; i < n; ++i) {
+                        in[i].fill(0);
+                        for (std::size_t j = 0; j < width; ++j) in[i][j] = f[first + j][i];
+                    }
+                    for (auto& x : single) x.fill(0);
+                    for (auto& x : pair) x.fill(0);
+
+                    for (std::size_t i = 0; i < n; ++i) {
+                        for (auto k = singleStart[i]; k < singleStart[i + 1]; ++k) {
+                            auto& out = single[singleRows[k]];
+                            const double w = singleWeights[k];
+                            for (std::size_t j = 0; j < block; ++j) out[j] += w * in[i][j];
+                        }
+                    }
+
+                    for (std::size_t o = 0; o < offsetProbabilities.size(); ++o) {
+                        const auto* lo = lower.data() + o * n * n;
+                        const auto* up = upper.data() + o * n * n;
+                        const double po = offsetProbabilities[o];
+
+                        for (std::size_t a1 = 0; a1 < n; ++a1) {
+                            std::array<double, block> w1;
+                            for (std::size_t j = 0; j < block; ++j) w1[j] = po * in[a1][j];
+
+                            for (std::size_t a2 = 0; a2 < n; ++a2) {
+                                const auto k = a1 * n + a2;
+                                if (lo[k] == outside) continue;
+
+                                auto& out = pair[lo[k]];
+                                const double u = up[k];
+                                if (u == 0) {
+                                    for (std::size_t j = 0; j < block; ++j) out[j] += w1[j] * in[a2][j];
+                                    continue;
+                                }
+
+                                auto& next = pair[lo[k] + 1];
+                                for (std::size_t j = 0; j < block; ++j) {
+                                    const auto w = w1[j] * in[a2][j];
+                                    out[j] += w * (1 - u);
+                                    next[j] += w * u;
+                                }
+                            }
+                        }
+                    }
+
+                    for (std::size_t j = 0; j < width; ++j) {
+                        for (std::size_t b = 0; b < bins; ++b) {
+                            ret[first + j][b] = (1 - pileup) * single[b][j] + pileup * pair[b][j];
+                        }
+                    }
+                }
+            }
+        );
+
+        return ret;
+    } // <-- applyAll()
+
+    void save(BinaryWriter& w) const {
+        w.write(E);
+        w.write(cellEdges);
+        binning.save(w);
+        w.write(singleStart);
+        w.write(singleRows);
+        w.write(singleWeights);
+        w.write(offsetProbabilities);
+        w.write(lower);
+        w.write(upper);
+    } // <-- save()
+
+    static ResponseOperator load(BinaryReader& r) {
+        ResponseOperator ret;
+        ret.E = r.readVector<Real>();
+        ret.cellEdges = r.readVector<double>();
+        ret.binning = Binning::load(r);
+        ret.singleStart = r.readVector<std::uint32_t>();
+        ret.singleRows = r.readVector<std::uint32_t>();
+        ret.singleWeights = r.readVector<float>();
+        ret.offsetProbabilities = r.readVector<Real>();
+        ret.lower = r.readVector<std::uint32_t>();
+        ret.upper = r.readVector<float>();
+
+        const auto n = ret.E.size();
+        const auto kernel = ret.offsetProbabilities.size() * n * n;
+        if (
+            n < 2 || ret.cellEdges.size() != n + 1 || ret.singleStart.size() != n + 1
+            || ret.singleStart.back() != ret.singleRows.size() || ret.singleRows.size() != ret.singleWeights.size()
+            || ret.lower.size() != kernel || ret.upper.size() != kernel
+        ) {
+            throw std::runtime_error("Corrupted serialized ResponseOperator");
+        }
+
+        // Tables are indexed without checks, every bin they name must exist
+        const auto bins = ret.binning.bins();
+        if (
+            ret.singleStart.front() != 0
+            || !std::is_sorted(ret.singleStart.begin(), ret.singleStart.end())
+            || std::any_of(ret.singleRows.begin(), ret.singleRows.end(), [bins] (std::uint32_t b) { return b >= bins; })
+        ) {
+            throw std::runtime_error("Corrupted serialized ResponseOperator");
+        }
+        for (std::size_t k = 0; k < kernel; ++k) {
+            if (ret.lower[k] == outside) continue;
+            if (ret.lower[k] + std::uint64_t{ ret.upper[k] != 0 } >= bins) {
+                throw std::runtime_error("Corrupted serialized ResponseOperator");
+            }
+        }
+        return ret;
+    } // <-- load()
+}; // <-- class ResponseOperator
+
+} // <-- namespace edu28
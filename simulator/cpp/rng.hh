@@ -0,0 +1,114 @@
+#pragma once
+
+// Standard library
+#include <cmath>
+#include <cstdint>
+#include <random>
+
+#include "base.hh"
+
+namespace edu28 {
+
+/**
+ * \brief SplitMix64 output function
+ */
+constexpr std::uint64_t mix64(std::uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ull;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBull;
+    x ^= x >> 31;
+    return x;
+} // <-- mix64()
+
+/**
+ * \brief Counter-based random number generator
+ *
+ * The stream is fully determined by `(seed, counter)`, so roll number `i`
+ * of a run always draws the same numbers no matter which thread (or
+ * process) performs it.
+ */
+class CounterRng {
+    std::uint64_t state;
+
+public:
+    CounterRng(std::uint64_t seed, std::uint64_t counter)
+        : state(mix64(seed ^ mix64(counter + 0x9E3779B97F4A7C15ull)))
+    {}
+
+    /// \brief Next 64 random bits
+    std::uint64_t next() {
+        state += 0x9E3779B97F4A7C15ull;
+        return mix64(state);
+    } // <-- next()
+
+    /// \brief Uniform value in [0, 1)
+    Real uniform() {
+        if constexpr (sizeof(Real) <= sizeof(float)) {
+            return static_cast<Real>(next() >> 40) * static_cast<Real>(0x1.0p-24);
+        } else {
+            return static_cast<Real>(next() >> 11) * static_cast<Real>(0x1.0p-53);
+        }
+    } // <-- uniform()
+
+    /// \brief Uniform integer in [from, to]
+    int uniformInt(int from, int to) {
+        const auto range = static_cast<std::uint64_t>(to - from) + 1;
+        return from + static_cast<int>(((next() >> 32) * range) >> 32);
+    } // <-- uniformInt()
+
+    /// \brief Uniform double in [0, 1), regardless of `Real`
+    double uniformDouble() {
+        return static_cast<double>(next() >> 11) * 0x1.0p-53;
+    } // <-- uniformDouble()
+
+    /**
+     * \brief Poisson distributed count with the given mean
+     *
+     * Inversion for small means, Hörmann's PTRS transformed rejection otherwise
+     */
+    std::uint64_t poisson(double mean) {
+        if (!(mean > 0)) return 0;
+
+        if (mean < 10) {
+            const auto limit = std::exp(-mean);
+            std::uint64_t k = 0;
+            for (auto p = uniformDouble(); p > limit; p *= uniformDouble()) ++k;
+            return k;
+        }
+
+        const auto slam = std::sqrt(mean);
+        const auto loglam = std::log(mean);
+        const auto b = 0.931 + 2.53 * slam;
+        const auto a = -0.059 + 0.02483 * b;
+        const auto invAlpha = 1.1239 + 1.1328 / (b - 3.4);
+        const auto vr = 0.9277 - 3.6224 / (b - 2);
+
+        for (;;) {
+            const auto u = uniformDouble() - 0.5;
+            const auto v = uniformDouble();
+            const auto us = 0.5 - std::abs(u);
+            const auto k = std::floor((2 * a / us + b) * u + mean + 0.43);
+
+            if (us >= 0.07 && v <= vr) return static_cast<std::uint64_t>(k);
+            if (k < 0 || (us < 0.013 && v > us)) continue;
+
+            if (
+                std::log(v) + std::log(invAlpha) - std::log(a / (us * us) + b)
+                <= -mean + k * loglam - std::lgamma(k + 1)
+            ) {
+                return static_cast<std::uint64_t>(k);
+            }
+        }
+    } // <-- poisson()
+}; // <-- class CounterRng
+
+/**
+ * \brief A fresh non-deterministic seed
+ */
+std::uint64_t randomSeed() {
+    std::random_device rd{};
+    return (static_cast<std::uint64_t>(rd()) << 32) | rd();
+} // <-- randomSeed()
+
+} // <-- namespace edu28
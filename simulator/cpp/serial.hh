@@ -0,0 +1,154 @@
+#pragma once
+
+// Standard library
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "base.hh"
+
+namespace edu28 {
+
+/// \brief Implementation detail namespace
+namespace detail {
+
+    /// \brief Leading bytes of every serialized blob
+    constexpr std::string_view serialMagic = "edu28";
+
+    template <typename T>
+    struct IsTrivialVector : std::false_type {};
+    template <typename T, typename Alloc>
+    struct IsTrivialVector<std::vector<T, Alloc>> : std::is_trivially_copyable<T> {};
+
+    /// \brief 64-bit FNV-1a hash of a byte string, for fingerprints rather than security
+    constexpr std::uint64_t hashBytes(std::string_view bytes) {
+        std::uint64_t ret = 0xCBF29CE484222325ull;
+        for (const auto c : bytes) {
+            ret ^= static_cast<unsigned char>(c);
+            ret *= 0x100000001B3ull;
+        }
+        return ret;
+    } // <-- hashBytes()
+
+} // <-- namespace detail
+
+/**
+ * \brief Appends raw values to a byte buffer
+ *
+ * Trivially copyable values and vectors of them are stored with `memcpy`.
+ * The buffer starts with a header recording `sizeof(Real)`, so modules
+ * built with different `REAL` refuse each other's data.
+ */
+class BinaryWriter {
+    std::string buffer;
+
+public:
+    BinaryWriter() {
+        buffer.append(detail::serialMagic);
+        buffer.push_back(static_cast<char>(sizeof(Real)));
+    } // <-- BinaryWriter()
+
+    template <typename T>
+    requires std::is_trivially_copyable_v<T>
+    void write(const T& value) {
+        buffer.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    } // <-- write()
+
+    template <typename T, typename Alloc>
+    requires std::is_trivially_copyable_v<T>
+    void write(const std::vector<T, Alloc>& values) {
+        write<std::uint64_t>(values.size());
+        buffer.append(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+    } // <-- write()
+
+    /// \brief Serialized data
+    const std::string& str() const { return buffer; }
+}; // <-- class BinaryWriter
+
+/**
+ * \brief Reads values written by \ref BinaryWriter
+ *
+ * \throws std::runtime_error on a foreign header or truncated data
+ */
+class BinaryReader {
+    std::string_view data;
+    std::size_t pos = 0;
+
+    void need(std::size_t bytes) const {
+        if (data.size() - pos < bytes) throw std::runtime_error("Serialized data is truncated");
+    } // <-- need()
+
+public:
+    explicit BinaryReader(std::string_view data) : data(data) {
+        need(detail::serialMagic.size() + 1);
+        if (data.substr(0, detail::serialMagic.size()) != detail::serialMagic) {
+            throw std::runtime_error("Not an edu28 serialized object");
+        }
+        pos = detail::serialMagic.size();
+        if (static_cast<std::size_t>(data[pos++]) != sizeof(Real)) {
+            throw std::runtime_error("Serialized object was created with a different Real type");
+        }
+    } // <-- BinaryReader()
+
+    template <typename T>
+    requires std::is_trivially_copyable_v<T>
+    T read() {
+        need(sizeof(T));
+        T ret;
+        std::memcpy(&ret, data.data() + pos, sizeof(T));
+        pos += sizeof(T);
+        return ret;
+    } // <-- read()
+
+    template <typename T, typename Alloc = std::allocator<T>>
+    requires std::is_trivially_copyable_v<T>
+    std::vector<T, Alloc> readVector() {
+        const auto size = read<std::uint64_t>();
+        if (size > (data.size() - pos) / sizeof(T)) throw std::runtime_error("Serialized data is truncated");
+
+        std::vector<T, Alloc> ret(size);
+        std::memcpy(ret.data(), data.data() + pos, size * sizeof(T));
+        pos += size * sizeof(T);
+        return ret;
+    } // <-- readVector()
+}; // <-- class BinaryReader
+
+/**
+ * \brief Serialize a value to bytes
+ *
+ * Works for trivially copyable types, vectors of them, and classes with
+ * `void save(BinaryWriter&) const`
+ */
+template <typename T>
+std::string serialize(const T& value) {
+    BinaryWriter writer;
+    if constexpr (std::is_trivially_copyable_v<T> || detail::IsTrivialVector<T>::value) {
+        writer.write(value);
+    } else {
+        value.save(writer);
+    }
+    return writer.str();
+} // <-- serialize()
+
+/**
+ * \brief Restore a value produced by \ref serialize()
+ *
+ * Classes need `static T load(BinaryReader&)`
+ */
+template <typename T>
+T deserialize(std::string_view data) {
+    BinaryReader reader(data);
+    if constexpr (std::is_trivially_copyable_v<T>) {
+        return reader.read<T>();
+    } else if constexpr (detail::IsTrivialVector<T>::value) {
+        return reader.readVector<typename T::value_type, typename T::allocator_type>();
+    } else {
+        return T::load(reader);
+    }
+} // <-- deserialize()
+
+} // <-- namespace edu28
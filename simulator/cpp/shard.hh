@@ -0,0 +1,319 @@
+#pragma once
+
+// Standard library
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "backend.hh"
+#include "base.hh"
+#include "context.hh"
+#include "hist.hh"
+#include "serial.hh"
+#include "sketch.hh"
+
+namespace edu28 {
+
+/**
+ * \brief Integral moments over one block of consecutive roll numbers
+ */
+struct BlockMoments {
+    /// \brief Sum of integrals
+    double sum = 0;
+    /// \brief Sum of squared deviations from the block mean, accumulated with Welford's update
+    double m2 = 0;
+}; // <-- struct BlockMoments
+
+/**
+ * \brief Mergeable partial state of a run over a range of roll numbers
+ *
+ * Roll numbers are grouped into blocks of \ref blockSize. Each block is
+ * always summed by one thread in order, and blocks are combined in roll
+ * number order, so merging the states of adjacent shards gives bit-for-bit
+ * the same result as one run over the whole range. The exception are the
+ * quantile sketches: they are merged per shard rather than per block, so
+ * they only agree within their error bounds.
+ */
+struct RunState {
+    /// \brief Roll numbers per moments block. Shard boundaries are aligned to it
+    static constexpr std::uint64_t blockSize = 1 << 16;
+
+    /// \brief RNG seed of the context that produced the state
+    std::uint64_t seed = 0;
+    /// \brief \ref SimulationContext::setupHash() of that context
+    std::uint64_t setup = 0;
+    /// \brief First roll number covered
+    std::uint64_t begin = 0;
+    /// \brief One past the last roll number covered
+    std::uint64_t end = 0;
+
+    /// \brief Border used for \ref counts
+    Real border = 0;
+    /// \brief Integral histogram
+    Histogram histogram;
+    /// \brief Rolls on either side of \ref border
+    BorderCounts counts;
+    /// \brief Integral sums, one entry per block
+    std::vector<BlockMoments> blocks;
+    /// \brief Integral and amplitude quantile sketches
+    RollSketches sketches;
+
+    /// \brief Number of rolls covered
+    std::uint64_t rolls() const { return end - begin; }
+
+    /// \brief Number of rolls in block `i`
+    std::uint64_t blockRolls(std::size_t i) const {
+        return std::min(RunState::blockSize, end - (begin + i * RunState::blockSize));
+    } // <-- blockRolls()
+
+    /// \brief Mean integral
+    double mean() const {
+        double sum = 0;
+        for (const auto& b : blocks) sum += b.sum;
+        return sum / static_cast<double>(rolls());
+    } // <-- mean()
+
+    /**
+     * \brief Integral variance
+     *
+     * Block moments are combined in order with Chan's pairwise update, which
+     * unlike `E[x^2] - E[x]^2` doesn't cancel away for means large against
+     * the spread
+     */
+    double variance() const {
+        double n = 0, mean = 0, m2 = 0;
+        for (std::size_t i = 0; i < blocks.size(); ++i) {
+            const auto nb = static_cast<double>(blockRolls(i));
+            if (nb == 0) continue;
+
+            const auto meanB = blocks[i].sum / nb;
+            const auto delta = meanB - mean;
+            const auto total = n + nb;
+
+            mean += delta * nb / total;
+            m2 += blocks[i].m2 + delta * delta * n * nb / total;
+            n = total;
+        }
+        return m2 / n;
+    } // <-- variance()
+
+    /**
+     * \brief Append the state of the directly following range
+     *
+     * \throws std::runtime_error if the states come from contexts with
+     *         different setups or seeds, use different binning, border or
+     *         sketch size, or the ranges aren't adjacent
+     */
+    RunState& operator+=(const RunState& other) {
+        if (other.seed != seed || other.setup != setup) {
+            throw std::runtime_error("Can't merge run states of different simulation setups or seeds");
+        }
+        if (other.border != border) {
+            throw std::runtime_error("Can't merge run states with different borders");
+        }
+        if (other.begin != end) {
+            throw std::runtime_error("Can't merge run states over non-adjacent roll ranges");
+        }
+
+        histogram += other.histogram;
+        counts += other.counts;
+        blocks.insert(blocks.end(), other.blocks.begin(), other.blocks.end());
+        sketches += other.sketches;
+        end = other.end;
+
+        return *this;
+    } // <-- operator+=()
+
+    void save(BinaryWriter& w) const {
+        w.write(seed);
+        w.write(setup);
+        w.write(begin);
+        w.write(end);
+        w.write(border);
+        histogram.save(w);
+        w.write(counts);
+        w.write(blocks);
+        sketches.save(w);
+    } // <-- save()
+
+    static RunState load(BinaryReader& r) {
+        RunState ret;
+        ret.seed = r.read<std::uint64_t>();
+        ret.setup = r.read<std::uint64_t>();
+        ret.begin = r.read<std::uint64_t>();
+        ret.end = r.read<std::uint64_t>();
+        ret.border = r.read<Real>();
+        ret.histogram = Histogram::load(r);
+        ret.counts = r.read<BorderCounts>();
+        ret.blocks = r.readVector<BlockMoments>();
+        ret.sketches = RollSketches::load(r);
+
+        if (ret.end < ret.begin || ret.blocks.size() != (ret.rolls() + blockSize - 1) / blockSize) {
+            throw std::runtime_error("Corrupted serialized RunState");
+        }
+        return ret;
+    } // <-- load()
+}; // <-- struct RunState
+
+/**
+ * \brief Roll number range of shard `shard` out of `shards`
+ *
+ * Splits [0, totalRolls) into contiguous ranges aligned to \ref RunState::blockSize
+ */
+std::pair<std::uint64_t, std::uint64_t> shardRange(
+    std::uint64_t totalRolls, std::uint64_t shard, std::uint64_t shards
+) {
+    if (shards == 0 || shard >= shards) throw std::runtime_error("Shard index out of range");
+
+    const auto blocks = (totalRolls + RunState::blockSize - 1) / RunState::blockSize;
+    const auto from = shard * blocks / shards;
+    const auto to = (shard + 1) * blocks / shards;
+
+    return {
+        std::min(from * RunState::blockSize, totalRolls),
+        std::min(to * RunState::blockSize, totalRolls)
+    };
+} // <-- shardRange()
+
+/**
+ * \brief Perform rolls number [begin, end) of `context`
+ *
+ * \param bins, lo, hi - integral histogram binning
+ * \param border       - border to count rolls against
+ * \param sketchK      - quantile sketch section size, see \ref QuantileSketch
+ *
+ * \throws std::runtime_error if `begin` isn't aligned to \ref RunState::blockSize
+ */
+RunState runRange(
+    const SimulationContext& context,
+    std::uint64_t begin, std::uint64_t end,
+    std::size_t bins, Real lo, Real hi,
+    Real border,
+    std::uint32_t sketchK = QuantileSketch::defaultK
+) {
+    if (begin % RunState::blockSize != 0 || end < begin) {
+        throw std::runtime_error("Run ranges must start at a multiple of RunState::blockSize");
+    }
+
+    RunState ret;
+    ret.seed = context.getSeed();
+    ret.setup = context.setupHash();
+    ret.begin = begin;
+    ret.end = end;
+    ret.border = border;
+    ret.blocks.resize((end - begin + RunState::blockSize - 1) / RunState::blockSize);
+    ret.sketches = RollSketches(sketchK, mix64(~context.getSeed() ^ begin));
+
+    const auto chunks = getConcurrency();
+    std::vector<Histogram> histograms(chunks, Histogram(bins, lo, hi));
+    std::vector<BorderCounts> counts(chunks);
+
+    // Per-chunk accumulators above are indexed by the `chunk` of every wave
+    detail::orderedBlocks(
+        ret.blocks.size(), chunks, RollSketches(sketchK),
+        [&] (RollSketches& sketches, std::size_t chunk, std::size_t block) {
+            const auto first = begin + block * RunState::blockSize;
+            const auto last = std::min(first + RunState::blockSize, end);
+
+            // Same block seeds as SimulationContext::sketches()
+            sketches = RollSketches(sketchK, mix64(context.getSeed() ^ first));
+
+            BlockMoments m;
+            double mean = 0, n = 0;
+            for (auto i = first; i < last; ++i) {
+                const auto r = context.roll(i);
+
+                histograms[chunk].fill(r.integral);
+                counts[chunk].left += (r.integral < border);
+                counts[chunk].right += (r.integral >= border);
+                const double x = r.integral;
+                m.sum += x;
+                n += 1;
+                const auto delta = x - mean;
+                mean += delta / n;
+                m.m2 += delta * (x - mean);
+                SimulationContext::fillSketches(sketches, r);
+            }
+            ret.blocks[block] = m;
+        },
+        [&ret] (const RollSketches& sketches) { ret.sketches += sketches; }
+    );
+
+    ret.histogram = Histogram(bins, lo, hi);
+    for (const auto& h : histograms) ret.histogram += h;
+    for (const auto& c : counts) ret.counts += c;
+
+    return ret;
+} // <-- runRange()
+
+/**
+ * \brief Perform shard `shard` out of `shards` of a `totalRolls` run
+ *
+ * See \ref shardRange() and \ref runRange()
+ */
+RunState runShard(
+    const SimulationContext& context,
+    std::uint64_t totalRolls, std::uint64_t shard, std::uint64_t shards,
+    std::size_t bins, Real lo, Real hi,
+    Real border,
+    std::uint32_t sketchK = QuantileSketch::defaultK
+) {
+    const auto [ begin, end ] = shardRange(totalRolls, shard, shards);
+    return runRange(context, begin, end, bins, lo, hi, border, sketchK);
+} // <-- runShard()
+
+/**
+ * \brief Merge shard states in any order
+ *
+ * \throws std::runtime_error if `states` is empty or the states can't be merged
+ */
+RunState mergeRunStates(std::vector<RunState> states) {
+    if (states.empty()) throw std::runtime_error("Nothing to merge");
+
+    std::sort(
+        states.begin(), states.end(),
+        [] (const RunState& a, const RunState& b) {
+            return std::pair(a.begin, a.end) < std::pair(b.begin, b.end);
+        }
+    );
+
+    RunState ret = std::move(states.front());
+    for (std::size_t i = 1; i < states.size(); ++i) ret += states[i];
+
+    return ret;
+} // <-- mergeRunStates()
+
+/**
+ * \brief Write a serialized object to a file
+ *
+ * \throws std::runtime_error on I/O errors
+ */
+template <typename T>
+void saveToFile(const std::string& path, const T& value) {
+    std::ofstream file(path, std::ios::binary);
+    const auto data = serialize(value);
+    file.write(data.data(), static_cast<std::streamsize>(data.size()));
+    if (!file) throw std::runtime_error("Can't write " + path);
+} // <-- saveToFile()
+
+/**
+ * \brief Read an object written by \ref saveToFile()
+ *
+ * \throws std::runtime_error on I/O errors or malformed data
+ */
+template <typename T>
+T loadFromFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) throw std::runtime_error("Can't read " + path);
+
+    const std::string data{ std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+    return deserialize<T>(data);
+} // <-- loadFromFile()
+
+} // <-- namespace edu28
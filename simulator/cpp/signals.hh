@@ -1,8 +1,12 @@
 #pragma once
 
-#include <thread>
+#include <functional>
+#include <string>
 
+#include "backend.hh"
 #include "base.hh"
+#include "budget.hh"
+#include "metrics.hh"
 #include "prob.hh"
 
 namespace edu28 {
@@ -92,6 +96,47 @@ Real integrateSignalRelative(const Signal& signal, Real offsetLeft, Real offsetR
     return integrateSignal(signal, center - offsetLeft, center + offsetRight);
 } // <-- Real integrateSignalsRelative()
 
+/**
+ * \brief Same as `integrateSignal(composeSignals(...), intFrom, intTo)`,
+ *        but without materializing the composed signal
+ *
+ * The composed value at every point is computed on the fly, so nothing
+ * is allocated
+ *
+ * \throws std::runtime_error if signal grids aren't aligned
+ */
+Real integrateComposedSignals(
+    const Signal& signal1,
+    const Signal& signal2,
+    Real offset,
+    Real amp1,
+    Real amp2,
+    Real intFrom, Real intTo
+) {
+    const auto& [ X, Y ] = signal1;
+    const auto& [ X2, Y2 ] = signal2;
+
+    // Calculate index offset
+    const std::size_t iOffset = [&X2, &X, offset] {
+        for (std::size_t i = 0; i < X2.size(); ++i) {
+            if (X2.at(i) - X.at(0) == offset) return i;
+        }
+
+        throw std::runtime_error("integrateComposedSignals expects `offset` argument to be in the signals' grids");
+    } ();
+
+    Real ret = 0;
+
+    for (std::size_t i = 0; i < X.size(); ++i) {
+        Real y = Y.at(i) * amp1;
+        if (i >= iOffset) y += Y2.at(i - iOffset) * amp2;
+
+        ret += ((X.at(i) >= intFrom) && (X.at(i) <= intTo)) * y;
+    }
+
+    return ret;
+} // <-- Real integrateComposedSignals()
+
 /**
  * \brief Double overlap roll result
  *
@@ -108,10 +153,58 @@ struct DoubleOverlapRollResult {
     Real integral;
 }; // <-- struct DoubleOverlapRollResult
 
+/// \brief Implementation detail namespace
+namespace detail {
+
+    /// \brief Roll the amplitudes of a double overlapped signal with the given offset
+    DoubleOverlapRollResult rollDoubleOverlapAt(
+        int offset,
+        const std::vector<Real>& E, const std::vector<Real>& P,
+        const Signal& signal,
+        Real intLeft, Real intRight
+    ) {
+        const Real amp1 = rollScalar(E, P);
+        const Real amp2 = rollScalar(E, P);
+
+        return DoubleOverlapRollResult{
+            offset, amp1, amp2,
+            integrateComposedSignals(signal, signal, offset, amp1, amp2, 9 - intLeft, 9 + intRight)
+        };
+    } // <-- rollDoubleOverlapAt()
+
+} // <-- namespace detail
+
+/**
+ * \brief Rolls a double overlapped signal
+ *
+ * Offset is drawn from `offsets`
+ * Amplitudes are determined as random values with distribution given by `P` and `E`
+ *
+ * \param E         - distribution E
+ * \param P         - distribution P
+ * \param signal    - signal shape
+ * \param intLeft   - left integration border (offset relative to 9)
+ * \param intRight  - right integration border (offset relative to 9)
+ * \param offsets   - signal peak offset distribution
+ *
+ * See \ref integrateSignalRelative() for better explaination of `intLeft` and `intRight`
+ */
+DoubleOverlapRollResult rollDoubleOverlap(
+    const std::vector<Real>& E, const std::vector<Real>& P,
+    const Signal& signal,
+    Real intLeft, Real intRight,
+    const OffsetDistribution& offsets
+) {
+    detail::ThreadRng rng;
+    const int offset = offsets(rng);
+    return detail::rollDoubleOverlapAt(offset, E, P, signal, intLeft, intRight);
+} // <-- DoubleOverlapRollResult rollDoubleOverlap()
+
 /**
  * \brief Rolls a double overlapped signal
  *
- * Offset is assumed to have a uniform integer distribution between offsetMin and offsetMax
+ * Offset is assumed to have a uniform integer distribution between offsetMin and offsetMax,
+ * same draws as with `OffsetDistribution::uniformRange(offsetMin, offsetMax)`.
  * Amplitudes are determined as random values with distribution given by `P` and `E`
  *
  * \param E         - distribution E
@@ -130,47 +223,39 @@ DoubleOverlapRollResult rollDoubleOverlap(
     Real intLeft, Real intRight,
     int offsetMin = 0, int offsetMax = 42
 ) {
+    // Drawn directly: building the distribution for a single roll would allocate
     const int offset = uniformRoll(offsetMin, offsetMax + 1);
-    const Real amp1 = rollScalar(E, P);
-    const Real amp2 = rollScalar(E, P);
-
-    return DoubleOverlapRollResult{
-        offset, amp1, amp2,
-        integrateSignalRelative(composeSignals(signal, signal, offset, amp1, amp2), intLeft, intRight)
-    };
+    return detail::rollDoubleOverlapAt(offset, E, P, signal, intLeft, intRight);
 } // <-- DoubleOverlapRollResult rollDoubleOverlap()
 
 /// \brief Implementation detail namespace
 namespace detail {
 
+    /**
+     * \brief Call `func(args...)` `bulkSize` times in parallel and collect the results
+     *
+     * \throws MemoryBudgetExceeded if the results don't fit into the memory budget
+     */
     template <typename Func, typename... Args>
     requires std::invocable<Func, Args...>
-    std::vector< std::invoke_result_t< Func, Args... > >
+    BulkResult< std::invoke_result_t< Func, Args... > >
     runInBulkHelper(std::size_t bulkSize, Func func, Args... args)
     {
-        const auto threads = std::thread::hardware_concurrency();
-
         using ResultType = std::invoke_result_t<Func, Args...>;
 
-        std::vector<ResultType> ret(bulkSize);
-        std::vector<std::thread> workers;
+        checkMemoryBudget(bytesFor<ResultType>(bulkSize), "Bulk run of " + std::to_string(bulkSize) + " rolls");
 
-        std::size_t start = 0;
-        for (std::size_t thread = 0; thread < threads; ++thread) {
-            std::size_t end = (thread == threads - 1) ? bulkSize : (start + bulkSize / threads);
+        BulkResult<ResultType> ret(bulkSize);
 
-            workers.emplace_back(
-                [start, end, &ret, &func, &args...] {
-                    for (std::size_t i = start; i < end; ++i) {
-                        ret[i] = std::invoke(func, args...);
-                    }
+        ret.metrics = meteredParallelFor(
+            bulkSize,
+            [&ret, &func, &args...] (std::size_t, std::size_t start, std::size_t end) {
+                for (std::size_t i = start; i < end; ++i) {
+                    ret[i] = std::invoke(func, args...);
                 }
-            );
-
-            start = end;
-        }
-
-        for (auto& t : workers) t.join();
+            }
+        );
+        ret.metrics.peakBytes = ret.capacity() * sizeof(ResultType);
 
         return ret;
     } // <-- runInBulkHelper()
@@ -180,23 +265,94 @@ namespace detail {
 /**
  * \brief Perform \ref rollDoubleOverlap in bulk
  */
-std::vector<DoubleOverlapRollResult> rollDoubleOverlapBulk(
+BulkResult<DoubleOverlapRollResult> rollDoubleOverlapBulk(
     std::size_t bulkSize,
     const std::vector<Real>& E, const std::vector<Real>& P,
     const Signal& signal,
     Real intLeft, Real intRight,
-    int offsetMin = 0, int offsetMax = 42
+    const OffsetDistribution& offsets
 ) {
     return detail::runInBulkHelper(
         bulkSize,
-        rollDoubleOverlap,
-        E, P, signal, intLeft, intRight, offsetMin, offsetMax
+        [&] { return rollDoubleOverlap(E, P, signal, intLeft, intRight, offsets); }
+    );
+} // <-- BulkResult<DoubleOverlapRollResult> rollDoubleOverlapBulk()
+
+/**
+ * \brief Perform \ref rollDoubleOverlap in bulk with uniform offsets in [offsetMin, offsetMax]
+ *
+ * \throws std::runtime_error if `offsetMax < offsetMin`
+ */
+BulkResult<DoubleOverlapRollResult> rollDoubleOverlapBulk(
+    std::size_t bulkSize,
+    const std::vector<Real>& E, const std::vector<Real>& P,
+    const Signal& signal,
+    Real intLeft, Real intRight,
+    int offsetMin = 0, int offsetMax = 42
+) {
+    return rollDoubleOverlapBulk(
+        bulkSize, E, P, signal, intLeft, intRight,
+        OffsetDistribution::uniformRange(offsetMin, offsetMax)
     );
-} // <-- std::vector<DoubleOverlapRollResult> rollDoubleOverlapBulk()
+} // <-- BulkResult<DoubleOverlapRollResult> rollDoubleOverlapBulk()
+
+/**
+ * \brief Perform \ref rollDoubleOverlap `rows` times writing into a caller's buffer
+ *
+ * Row `i` of `out` becomes `offset, amp1, amp2, integral`. Nothing is
+ * allocated, so `out` may be a memory-mapped file larger than the memory
+ * budget.
+ *
+ * \param out  - row-major `rows x 4` buffer
+ * \param rows - number of rolls
+ *
+ * See \ref rollDoubleOverlap() for the other arguments
+ */
+RunMetrics rollDoubleOverlapBulkInto(
+    Real* out, std::size_t rows,
+    const std::vector<Real>& E, const std::vector<Real>& P,
+    const Signal& signal,
+    Real intLeft, Real intRight,
+    const OffsetDistribution& offsets
+) {
+    return detail::meteredParallelFor(
+        rows,
+        [&] (std::size_t, std::size_t start, std::size_t end) {
+            for (std::size_t i = start; i < end; ++i) {
+                const auto r = rollDoubleOverlap(E, P, signal, intLeft, intRight, offsets);
+                Real* row = out + 4 * i;
+                row[0] = static_cast<Real>(r.offset);
+                row[1] = r.amp1;
+                row[2] = r.amp2;
+                row[3] = r.integral;
+            }
+        }
+    );
+} // <-- rollDoubleOverlapBulkInto()
+
+/**
+ * \brief \ref rollDoubleOverlapBulkInto() with uniform offsets in [offsetMin, offsetMax]
+ *
+ * \throws std::runtime_error if `offsetMax < offsetMin`
+ */
+RunMetrics rollDoubleOverlapBulkInto(
+    Real* out, std::size_t rows,
+    const std::vector<Real>& E, const std::vector<Real>& P,
+    const Signal& signal,
+    Real intLeft, Real intRight,
+    int offsetMin = 0, int offsetMax = 42
+) {
+    return rollDoubleOverlapBulkInto(
+        out, rows, E, P, signal, intLeft, intRight,
+        OffsetDistribution::uniformRange(offsetMin, offsetMax)
+    );
+} // <-- rollDoubleOverlapBulkInto()
 
 /**
  * \brief Single signal roll result - integral of the signal
  *
+ * Scales the signal on the fly instead of copying it
+ *
  * \param E         - distribution E
  * \param P         - distribution P
  * \param signal    - signal shape
@@ -205,22 +361,27 @@ std::vector<DoubleOverlapRollResult> rollDoubleOverlapBulk(
  */
 Real rollSingle(
     const std::vector<Real>& E, const std::vector<Real>& P,
-    Signal signal,
+    const Signal& signal,
     Real intLeft, Real intRight
 ) {
     const Real amp = rollScalar(E, P);
 
-    // Transform signal to the new amplitude
-    auto& [ X, Y ] = signal;
-    for (auto& y : Y) y *= amp;
+    const auto& [ X, Y ] = signal;
+    const Real intFrom = 9 - intLeft;
+    const Real intTo = 9 + intRight;
+
+    Real ret = 0;
+    for (std::size_t i = 0; i < X.size(); ++i) {
+        ret += ((X[i] >= intFrom) && (X[i] <= intTo)) * (Y[i] * amp);
+    }
 
-    return integrateSignalRelative(signal, intLeft, intRight);
+    return ret;
 } // <-- std::vector<Real> rollSingle()
 
 /**
  * \brief Perform \ref rollSingle in bulk
  */
-std::vector<Real> rollSingleBulk(
+BulkResult<Real> rollSingleBulk(
     std::size_t bulkSize,
     const std::vector<Real>& E, const std::vector<Real>& P,
     const Signal& signal,
@@ -231,6 +392,6 @@ std::vector<Real> rollSingleBulk(
         rollSingle,
         E, P, signal, intLeft, intRight
     );
-} // <-- std::vector<Real> rollSingelBulk()
+} // <-- BulkResult<Real> rollSingelBulk()
 
 } // <-- namespace edu28
@@ -0,0 +1,346 @@
+#pragma once
+
+// Standard library
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "base.hh"
+#include "rng.hh"
+#include "serial.hh"
+
+namespace edu28 {
+
+/**
+ * \brief Mergeable quantile sketch with relative error towards high ranks
+ *
+ * A KLL-style stack of compactors. When a compactor overflows, it sorts its
+ * items, keeps the largest ones and promotes every other of the smallest
+ * ones to the next level with twice the weight. How many items are kept
+ * follows the relative compactor schedule (Cormode et al., "Relative Error
+ * Streaming Quantiles"), so the rank error of a value shrinks with the
+ * number of values above it: high quantiles like 99.99% stay accurate.
+ *
+ * Memory grows only logarithmically with the number of values. Compaction
+ * coins come from a \ref CounterRng stream, so the same sequence of
+ * updates and merges always yields the same sketch.
+ */
+class QuantileSketch {
+public:
+    /// \brief Default section size
+    static constexpr std::uint32_t defaultK = 32;
+
+private:
+    /// \brief Smallest section size reached by halving
+    static constexpr std::uint32_t minSectionSize = 4;
+    /// \brief Sections per compactor initially
+    static constexpr std::uint32_t initSections = 3;
+
+    /// \brief One level of the sketch, every item weighs `2^level`
+    struct Compactor {
+        std::vector<double> items;
+        /// \brief Length of the sorted prefix of \ref items
+        std::size_t sorted = 0;
+        double sectionSizeF = 0;
+        std::uint32_t sectionSize = 0;
+        std::uint32_t sections = initSections;
+        /// \brief Number of compactions performed
+        std::uint64_t state = 0;
+
+        std::size_t capacity() const { return 2 * std::size_t{ sections } * sectionSize; }
+    }; // <-- struct Compactor
+
+    std::uint32_t k = defaultK;
+    std::uint64_t seed = 0;
+    std::uint64_t coins = 0;
+
+    std::uint64_t n = 0;
+    double minValue = std::numeric_limits<double>::infinity();
+    double maxValue = -std::numeric_limits<double>::infinity();
+
+    std::vector<Compactor> levels;
+    /// \brief Merge buffer, swapped with compactor items
+    std::vector<double> scratch;
+
+    Compactor emptyCompactor() const {
+        Compactor c;
+        c.sectionSizeF = k;
+        c.sectionSize = k;
+        return c;
+    } // <-- emptyCompactor()
+
+    /// \brief Compact level `h` into level `h + 1`
+    void compactLevel(std::size_t h) {
+        if (h + 1 == levels.size()) levels.push_back(emptyCompactor());
+
+        auto& c = levels[h];
+
+        // Double the number of sections once the schedule runs out of them
+        if (
+            c.state >= (std::uint64_t{ 1 } << std::min<std::uint32_t>(c.sections - 1, 63))
+            && c.sectionSize > minSectionSize
+        ) {
+            c.sectionSizeF /= std::sqrt(2.0);
+            c.sectionSize = std::max(minSectionSize, 2 * static_cast<std::uint32_t>(std::lround(c.sectionSizeF / 2)));
+            c.sections *= 2;
+        }
+
+        // Items left by the previous compaction are still sorted
+        const auto mid = c.items.begin() + static_cast<std::ptrdiff_t>(c.sorted);
+        std::sort(mid, c.items.end());
+        scratch.resize(c.items.size());
+        std::merge(c.items.begin(), mid, mid, c.items.end(), scratch.begin());
+        std::swap(c.items, scratch);
+
+        const auto toCompact = std::min<std::uint32_t>(std::countr_one(c.state) + 1, c.sections);
+        const auto keep = c.capacity() / 2 + std::size_t{ c.sections - toCompact } * c.sectionSize;
+
+        auto size = (c.items.size() > keep) ? c.items.size() - keep : 0;
+        size -= size % 2;
+        if (size == 0) return;
+
+        CounterRng rng(seed, coins++);
+        const auto offset = static_cast<std::size_t>(rng.next() >> 63);
+
+        auto& next = levels[h + 1].items;
+        for (std::size_t i = offset; i < size; i += 2) next.push_back(c.items[i]);
+        c.items.erase(c.items.begin(), c.items.begin() + static_cast<std::ptrdiff_t>(size));
+        c.sorted = c.items.size();
+
+        ++c.state;
+    } // <-- compactLevel()
+
+    /// \brief Compact every overflowing level, bottom to top
+    void compress() {
+        for (std::size_t h = 0; h < levels.size(); ++h) {
+            while (levels[h].items.size() >= levels[h].capacity()) compactLevel(h);
+        }
+    } // <-- compress()
+
+    /// \brief Retained items with their weights, sorted by value
+    std::vector<std::pair<double, std::uint64_t>> sortedView() const {
+        std::vector<std::pair<double, std::uint64_t>> ret;
+        for (std::size_t h = 0; h < levels.size(); ++h) {
+            for (const auto x : levels[h].items) ret.emplace_back(x, std::uint64_t{ 1 } << h);
+        }
+        std::sort(ret.begin(), ret.end());
+        return ret;
+    } // <-- sortedView()
+
+public:
+    /**
+     * \param k    - section size, larger is more accurate. Must be even and at least 4
+     * \param seed - seed of the compaction coins
+     *
+     * \throws std::runtime_error if `k` is invalid
+     */
+    explicit QuantileSketch(std::uint32_t k = defaultK, std::uint64_t seed = 0) : k(k), seed(seed) {
+        if (k < minSectionSize || k % 2 != 0) {
+            throw std::runtime_error("QuantileSketch expects an even k >= 4");
+        }
+        levels.push_back(emptyCompactor());
+    } // <-- QuantileSketch()
+
+    /// \brief Add a value
+    void fill(double x) {
+        minValue = std::min(minValue, x);
+        maxValue = std::max(maxValue, x);
+        ++n;
+
+        levels.front().items.push_back(x);
+        if (levels.front().items.size() >= levels.front().capacity()) compress();
+    } // <-- fill()
+
+    /**
+     * \brief Merge another sketch into this one
+     *
+     * \throws std::runtime_error if the section sizes differ
+     */
+    QuantileSketch& operator+=(const QuantileSketch& other) {
+        if (other.k != k) throw std::runtime_error("Can't merge quantile sketches with different k");
+
+        n += other.n;
+        minValue = std::min(minValue, other.minValue);
+        maxValue = std::max(maxValue, other.maxValue);
+
+        while (levels.size() < other.levels.size()) levels.push_back(emptyCompactor());
+        for (std::size_t h = 0; h < other.levels.size(); ++h) {
+            auto& c = levels[h];
+            const auto& o = other.levels[h];
+
+            c.items.insert(c.items.end(), o.items.begin(), o.items.end());
+            c.state |= o.state;
+            if (o.sections > c.sections) {
+                c.sections = o.sections;
+                c.sectionSize = o.sectionSize;
+                c.sectionSizeF = o.sectionSizeF;
+            }
+        }
+
+        compress();
+        return *this;
+    } // <-- operator+=()
+
+    /// \brief Section size
+    std::uint32_t getK() const { return k; }
+    /// \brief Number of values added
+    std::uint64_t count() const { return n; }
+    /// \brief Smallest value added
+    double min() const { return minValue; }
+    /// \brief Largest value added
+    double max() const { return maxValue; }
+    /// \brief Whether no compaction happened yet, so queries are exact
+    bool isExact() const { return levels.size() == 1; }
+
+    /// \brief Number of values stored
+    std::size_t retained() const {
+        std::size_t ret = 0;
+        for (const auto& c : levels) ret += c.items.size();
+        return ret;
+    } // <-- retained()
+
+    /**
+     * \brief Fraction of values at or below `x`
+     */
+    double rank(double x) const {
+        if (n == 0) return 0;
+
+        std::uint64_t w = 0;
+        for (std::size_t h = 0; h < levels.size(); ++h) {
+            for (const auto item : levels[h].items) w += (item <= x) ? (std::uint64_t{ 1 } << h) : 0;
+        }
+        return static_cast<double>(w) / static_cast<double>(n);
+    } // <-- rank()
+
+    /**
+     * \brief Smallest stored value with \ref rank() at least `q`
+     *
+     * \throws std::runtime_error if the sketch is empty or `q` isn't in [0, 1]
+     */
+    double quantile(double q) const {
+        return quantiles({ q }).front();
+    } // <-- quantile()
+
+    /**
+     * \brief \ref quantile() for several fractions at once
+     */
+    std::vector<double> quantiles(const std::vector<double>& qs) const {
+        if (n == 0) throw std::runtime_error("Quantile of an empty sketch");
+
+        const auto view = sortedView();
+
+        std::vector<double> ret;
+        ret.reserve(qs.size());
+        for (const auto q : qs) {
+            if (!(q >= 0 && q <= 1)) throw std::runtime_error("Quantile must be in [0, 1]");
+            if (q == 0) { ret.push_back(minValue); continue; }
+            if (q == 1) { ret.push_back(maxValue); continue; }
+
+            const auto target = q * static_cast<double>(n);
+            std::uint64_t w = 0;
+            double value = maxValue;
+            for (const auto& [ x, weight ] : view) {
+                w += weight;
+                if (static_cast<double>(w) >= target) { value = x; break; }
+            }
+            ret.push_back(value);
+        }
+        return ret;
+    } // <-- quantiles()
+
+    /**
+     * \brief Standard error of \ref rank() near rank `r`
+     *
+     * Empirical constants of the relative compactor: the error is at most
+     * `0.084 / k` and shrinks as `0.131 / k * (1 - r)` towards the top.
+     * Zero while \ref isExact()
+     */
+    double rankError(double r) const {
+        if (isExact()) return 0;
+
+        const auto fixed = 0.084 / k;
+        const auto relative = std::sqrt(0.0512 / initSections) / k * (1 - r);
+        return std::min(fixed, relative);
+    } // <-- rankError()
+
+    void save(BinaryWriter& w) const {
+        w.write(k);
+        w.write(seed);
+        w.write(coins);
+        w.write(n);
+        w.write(minValue);
+        w.write(maxValue);
+        w.write<std::uint64_t>(levels.size());
+        for (const auto& c : levels) {
+            w.write(c.items);
+            w.write(c.sectionSizeF);
+            w.write(c.sectionSize);
+            w.write(c.sections);
+            w.write(c.state);
+        }
+    } // <-- save()
+
+    static QuantileSketch load(BinaryReader& r) {
+        const auto k = r.read<std::uint32_t>();
+        const auto seed = r.read<std::uint64_t>();
+
+        QuantileSketch ret(k, seed);
+        ret.coins = r.read<std::uint64_t>();
+        ret.n = r.read<std::uint64_t>();
+        ret.minValue = r.read<double>();
+        ret.maxValue = r.read<double>();
+
+        const auto size = r.read<std::uint64_t>();
+        if (size == 0 || size > 64) throw std::runtime_error("Corrupted serialized QuantileSketch");
+
+        ret.levels.resize(size);
+        for (auto& c : ret.levels) {
+            c.items = r.readVector<double>();
+            c.sectionSizeF = r.read<double>();
+            c.sectionSize = r.read<std::uint32_t>();
+            c.sections = r.read<std::uint32_t>();
+            c.state = r.read<std::uint64_t>();
+            if (c.sectionSize == 0 || c.sections == 0) throw std::runtime_error("Corrupted serialized QuantileSketch");
+        }
+        return ret;
+    } // <-- load()
+}; // <-- class QuantileSketch
+
+/**
+ * \brief Quantile sketches of double overlap roll outputs
+ */
+struct RollSketches {
+    /// \brief Window integrals
+    QuantileSketch integral;
+    /// \brief Amplitudes, both signals of every roll
+    QuantileSketch amplitude;
+
+    explicit RollSketches(std::uint32_t k = QuantileSketch::defaultK, std::uint64_t seed = 0)
+        : integral(k, seed), amplitude(k, mix64(seed))
+    {}
+
+    RollSketches& operator+=(const RollSketches& other) {
+        integral += other.integral;
+        amplitude += other.amplitude;
+        return *this;
+    } // <-- operator+=()
+
+    void save(BinaryWriter& w) const {
+        integral.save(w);
+        amplitude.save(w);
+    } // <-- save()
+
+    static RollSketches load(BinaryReader& r) {
+        RollSketches ret;
+        ret.integral = QuantileSketch::load(r);
+        ret.amplitude = QuantileSketch::load(r);
+        return ret;
+    } // <-- load()
+}; // <-- struct RollSketches
+
+} // <-- namespace edu28
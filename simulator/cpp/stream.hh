@@ -0,0 +1,254 @@
+#pragma once
+
+// Standard library
+#include <algorithm>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <numeric>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "alloc.hh"
+#include "backend.hh"
+#include "base.hh"
+#include "metrics.hh"
+#include "queue.hh"
+#include "signals.hh"
+
+namespace edu28 {
+
+/// \brief Implementation detail namespace
+namespace detail {
+
+    /**
+     * \brief Streaming counterpart of \ref runInBulkHelper()
+     *
+     * Workers publish results in blocks of `blockSize` into `queue` instead of
+     * filling one big vector. The queue is closed once every worker is done.
+     * If the queue gets closed early (consumer went away), workers stop
+     * at the next block boundary.
+     *
+     * Runs `chunks` chunks on `pool`: workers block while the consumer lags,
+     * which mustn't stall the bulk calls sharing \ref ThreadPool::global().
+     *
+     * \return metrics of the rolls actually performed
+     */
+    template <typename Func, typename... Args>
+    requires std::invocable<Func, Args...>
+    RunMetrics streamInBulkHelper(
+        MPMCQueue< BulkVector< std::invoke_result_t< Func, Args... > > >& queue,
+        ThreadPool& pool, std::size_t chunks,
+        std::size_t bulkSize, std::size_t blockSize,
+        Func func, Args... args
+    ) {
+        using ResultType = std::invoke_result_t<Func, Args...>;
+
+        blockSize = std::max<std::size_t>(blockSize, 1);
+
+        std::vector<std::size_t> done(chunks, 0);
+        auto ret = meteredParallelFor(
+            pool, bulkSize, chunks,
+            [blockSize, &queue, &done, &func, &args...] (std::size_t chunk, std::size_t start, std::size_t end) {
+                for (std::size_t i = start; i < end; ) {
+                    const auto size = std::min(blockSize, end - i);
+
+                    BulkVector<ResultType> block(size);
+                    for (auto& r : block) r = std::invoke(func, args...);
+
+                    if (!queue.push(std::move(block))) return;
+                    i += size;
+                    done[chunk] = i - start;
+                }
+            }
+        );
+
+        queue.close();
+
+        ret.rolls = std::accumulate(done.begin(), done.end(), std::uint64_t{ 0 });
+        // Every worker holds one block while the queue is full
+        ret.peakBytes = (queue.capacity() + done.size()) * blockSize * sizeof(ResultType);
+
+        return ret;
+    } // <-- streamInBulkHelper()
+
+} // <-- namespace detail
+
+/**
+ * \brief A bulk roll running in the background and publishing result blocks
+ *
+ * Producers are throttled when the consumer lags behind by more than
+ * `capacity` blocks. They run on a pool owned by the stream, so a stalled
+ * consumer only parks its own stream's threads. Destroying the stream cancels
+ * the remaining rolls.
+ */
+template <typename Result>
+class RollStream {
+public:
+    /// \brief A block of roll results
+    using Block = BulkVector<Result>;
+
+private:
+    MPMCQueue<Block> queue;
+    RunMetrics runMetrics;
+    std::exception_ptr error;
+    std::size_t chunks;
+    ThreadPool pool;
+    std::thread producer;
+
+    /// \brief Wait for the producers, rethrow what stopped them
+    void finish() {
+        if (producer.joinable()) producer.join();
+        if (error) std::rethrow_exception(error);
+    } // <-- finish()
+
+public:
+    /**
+     * \brief Start streaming
+     *
+     * Rolls are split into \ref getConcurrency() chunks, read once here. The
+     * producer thread works on a chunk too, so the pool gets one worker less.
+     *
+     * \param capacity  - maximum number of blocks waiting for a consumer
+     * \param bulkSize  - total number of rolls
+     * \param blockSize - number of rolls per published block
+     * \param func      - roll function
+     * \param args      - roll function arguments. Copied into the stream
+     */
+    template <typename Func, typename... Args>
+    RollStream(
+        std::size_t capacity, std::size_t bulkSize, std::size_t blockSize,
+        Func func, Args... args
+    ) : queue(capacity),
+        chunks(getConcurrency()),
+        pool(chunks - 1),
+        producer(
+            [this, bulkSize, blockSize, func, args...] {
+                try {
+                    runMetrics = detail::streamInBulkHelper(queue, pool, chunks, bulkSize, blockSize, func, args...);
+                } catch (...) {
+                    error = std::current_exception();
+                    queue.close();
+                }
+            }
+        )
+    {}
+
+    RollStream(const RollStream&) = delete;
+    RollStream& operator=(const RollStream&) = delete;
+
+    ~RollStream() {
+        queue.close();
+        if (producer.joinable()) producer.join();
+    } // <-- ~RollStream()
+
+    /**
+     * \brief Wait for the next block
+     *
+     * \return `std::nullopt` when the stream is exhausted
+     * \throws what a roll threw, once the blocks published before are consumed
+     */
+    std::optional<Block> next() {
+        Block block;
+        if (queue.pop(block)) return block;
+        finish();
+        return std::nullopt;
+    } // <-- next()
+
+    /**
+     * \brief Feed every remaining block into `sink`
+     *
+     * \param sink - callable accepting `Block&&`
+     */
+    template <typename Sink>
+    void consume(Sink sink) {
+        Block block;
+        while (queue.pop(block)) std::invoke(sink, std::move(block));
+        finish();
+    } // <-- consume()
+
+    /// \brief Stop the producers. Already published blocks may still be consumed
+    void cancel() { queue.close(); }
+
+    /**
+     * \brief Performance of the producers
+     *
+     * Waits for them to finish, so only call it once the stream is exhausted
+     * or cancelled
+     */
+    const RunMetrics& metrics() {
+        finish();
+        return runMetrics;
+    } // <-- metrics()
+}; // <-- class RollStream
+
+/**
+ * \brief Start \ref rollDoubleOverlap in bulk, streaming the results
+ *
+ * \param capacity  - maximum number of blocks waiting for a consumer
+ * \param blockSize - number of rolls per block
+ *
+ * See \ref rollDoubleOverlap() for the other arguments
+ */
+std::unique_ptr<RollStream<DoubleOverlapRollResult>> rollDoubleOverlapStream(
+    std::size_t capacity, std::size_t bulkSize, std::size_t blockSize,
+    const std::vector<Real>& E, const std::vector<Real>& P,
+    const Signal& signal,
+    Real intLeft, Real intRight,
+    OffsetDistribution offsets
+) {
+    return std::make_unique<RollStream<DoubleOverlapRollResult>>(
+        capacity, bulkSize, blockSize,
+        [] (
+            const std::vector<Real>& E, const std::vector<Real>& P,
+            const Signal& signal,
+            Real intLeft, Real intRight,
+            const OffsetDistribution& offsets
+        ) {
+            return rollDoubleOverlap(E, P, signal, intLeft, intRight, offsets);
+        },
+        E, P, signal, intLeft, intRight, std::move(offsets)
+    );
+} // <-- rollDoubleOverlapStream()
+
+/**
+ * \brief \ref rollDoubleOverlapStream() with uniform offsets in [offsetMin, offsetMax]
+ *
+ * \throws std::runtime_error if `offsetMax < offsetMin`
+ */
+std::unique_ptr<RollStream<DoubleOverlapRollResult>> rollDoubleOverlapStream(
+    std::size_t capacity, std::size_t bulkSize, std::size_t blockSize,
+    const std::vector<Real>& E, const std::vector<Real>& P,
+    const Signal& signal,
+    Real intLeft, Real intRight,
+    int offsetMin = 0, int offsetMax = 42
+) {
+    return rollDoubleOverlapStream(
+        capacity, bulkSize, blockSize, E, P, signal, intLeft, intRight,
+        OffsetDistribution::uniformRange(offsetMin, offsetMax)
+    );
+} // <-- rollDoubleOverlapStream()
+
+/**
+ * \brief Start \ref rollSingle in bulk, streaming the results
+ *
+ * \param capacity  - maximum number of blocks waiting for a consumer
+ * \param blockSize - number of rolls per block
+ *
+ * See \ref rollSingle() for the other arguments
+ */
+std::unique_ptr<RollStream<Real>> rollSingleStream(
+    std::size_t capacity, std::size_t bulkSize, std::size_t blockSize,
+    const std::vector<Real>& E, const std::vector<Real>& P,
+    const Signal& signal,
+    Real intLeft, Real intRight
+) {
+    return std::make_unique<RollStream<Real>>(
+        capacity, bulkSize, blockSize,
+        rollSingle,
+        E, P, signal, intLeft, intRight
+    );
+} // <-- rollSingleStream()
+
+} // <-- namespace edu28
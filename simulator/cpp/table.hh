@@ -0,0 +1,283 @@
+#pragma once
+
+// Standard library
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "backend.hh"
+#include "base.hh"
+#include "bootstrap.hh"
+#include "context.hh"
+#include "prob.hh"
+#include "serial.hh"
+#include "signals.hh"
+
+namespace edu28 {
+
+/**
+ * \brief Interpolated pile-up ratio with its uncertainty
+ */
+struct RatioEstimate {
+    /// \brief Interpolated ratio
+    double ratio = 0;
+    /// \brief Interpolated statistical error of the grid values
+    double statError = 0;
+    /// \brief Interpolation error bound from grid second differences
+    double interpError = 0;
+}; // <-- struct RatioEstimate
+
+/**
+ * \brief Pile-up ratio precomputed on an HV x left x right x border grid
+ *
+ * Every grid value is \ref SimulationContext::analyticRatio() of the
+ * spectrum measured at that HV, so building needs no rolls. Queries
+ * interpolate `log(ratio)` multilinearly between the 16 surrounding grid
+ * points: the ratio grows about exponentially with the border, which a
+ * linear interpolation of the ratio itself would badly overestimate.
+ *
+ * The interpolation error of every axis is estimated as
+ * `|f''| / 2 * (x - x0) * (x1 - x)` for `f = log(ratio)`, with `f''` from
+ * second differences at the ends of the cell, and summed over the axes.
+ * Axes with less than three points contribute nothing.
+ */
+class RatioTable {
+public:
+    /// \brief Number of grid axes
+    static constexpr std::size_t dims = 4;
+
+private:
+    /// \brief Grid points along HV, left, right and border
+    std::array<std::vector<Real>, dims> axes;
+    /// \brief Ratio logarithms, border index fastest
+    std::vector<float> values;
+    /// \brief Relative statistical errors, same layout. Empty if not estimated
+    std::vector<float> errors;
+
+    std::size_t flatIndex(const std::array<std::size_t, dims>& idx) const {
+        std::size_t ret = 0;
+        for (std::size_t d = 0; d < dims; ++d) ret = ret * axes[d].size() + idx[d];
+        return ret;
+    } // <-- flatIndex()
+
+    /**
+     * \brief `f''` along axis `d` at grid point `idx`, moved inside the axis
+     */
+    double secondDerivative(std::array<std::size_t, dims> idx, std::size_t d) const {
+        const auto& x = axes[d];
+        idx[d] = std::clamp<std::size_t>(idx[d], 1, x.size() - 2);
+
+        const auto i = idx[d];
+        const auto fi = static_cast<double>(values[flatIndex(idx)]);
+        idx[d] = i - 1;
+        const auto fl = static_cast<double>(values[flatIndex(idx)]);
+        idx[d] = i + 1;
+        const auto fr = static_cast<double>(values[flatIndex(idx)]);
+
+        const double hl = x[i] - x[i - 1];
+        const double hr = x[i + 1] - x[i];
+        return 2 * ((fr - fi) / hr - (fi - fl) / hl) / (hl + hr);
+    } // <-- secondDerivative()
+
+public:
+    RatioTable() = default;
+
+    /**
+     * \brief Compute the table
+     *
+     * \param hv       - HV of every spectrum, ascending
+     * \param E        - amplitude grid of every spectrum
+     * \param counts   - raw counts of every spectrum
+     * \param signal   - signal shape
+     * \param lefts    - left integration borders, ascending
+     * \param rights   - right integration borders, ascending
+     * \param borders  - ratio borders, ascending
+     * \param offsets  - second signal peak offset distribution
+     * \param replicas - Poisson bootstrap replicas for the statistical error,
+     *                   see \ref SpectrumBootstrap. Less than two skip it
+     * \param seed     - bootstrap seed
+     *
+     * \throws std::runtime_error if an axis is empty or not ascending, the
+     *         numbers of spectra don't match, a spectrum isn't a valid
+     *         \ref Distribution, or a window doesn't fit the signal grid.
+     *         All checked before any ratio is computed
+     */
+    static RatioTable build(
+        const std::vector<Real>& hv,
+        const std::vector<std::vector<Real>>& E, const std::vector<std::vector<Real>>& counts,
+        const Signal& signal,
+        const std::vector<Real>& lefts, const std::vector<Real>& rights, const std::vector<Real>& borders,
+        const OffsetDistribution& offsets,
+        std::size_t replicas = 0, std::uint64_t seed = 0
+    ) {
+        if (E.size() != hv.size() || counts.size() != hv.size()) {
+            throw std::runtime_error("RatioTable expects one spectrum per HV");
+        }
+
+        RatioTable ret;
+        ret.axes = { hv, lefts, rights, borders };
+        for (const auto& axis : ret.axes) {
+            if (axis.empty() || std::adjacent_find(axis.begin(), axis.end(), std::greater_equal<Real>{}) != axis.end()) {
+                throw std::runtime_error("RatioTable expects non-empty strictly ascending axes");
+            }
+        }
+
+        const auto nb = borders.size();
+        const auto windows = lefts.size() * rights.size();
+
+        // Everything that can throw is built here: a throw inside the loop
+        // would only surface after the other tasks ran
+        std::vector<Distribution> spectra;
+        std::vector<SpectrumBootstrap> bootstraps;
+        spectra.reserve(hv.size());
+        for (std::size_t h = 0; h < hv.size(); ++h) {
+            spectra.emplace_back(E[h], counts[h]);
+            // Same replicas for every border and window of an HV
+            if (replicas > 1) bootstraps.emplace_back(E[h], counts[h], mix64(seed ^ h));
+        }
+
+        std::vector<SimulationContext> contexts;
+        contexts.reserve(windows);
+        for (const auto left : lefts) {
+            for (const auto right : rights) contexts.emplace_back(spectra.front(), signal, left, right, offsets);
+        }
+
+        ret.values.resize(hv.size() * windows * nb);
+        if (replicas > 1) ret.errors.resize(ret.values.size());
+
+        // One task per (HV, window), a task computes every border
+        detail::parallelFor(
+            hv.size() * windows, hv.size() * windows,
+            [&] (std::size_t, std::size_t start, std::size_t end) {
+                for (auto task = start; task < end; ++task) {
+                    const auto h = task / windows;
+                    const auto base = task * nb;
+
+                    const auto context = contexts[task % windows].withAmplitudes(spectra[h]);
+                    for (std::size_t b = 0; b < nb; ++b) {
+                        ret.values[base + b] = static_cast<float>(std::log(context.analyticRatio(borders[b])));
+                    }
+
+                    if (replicas < 2) continue;
+
+                    std::vector<double> sum(nb, 0), sumSq(nb, 0);
+                    for (std::size_t i = 0; i < replicas; ++i) {
+                        const auto replica = context.withAmplitudes(Distribution(E[h], bootstraps[h].replica(i)));
+                        for (std::size_t b = 0; b < nb; ++b) {
+                            const auto x = replica.analyticRatio(borders[b]);
+                            sum[b] += x;
+                            sumSq[b] += x * x;
+                        }
+                    }
+                    for (std::size_t b = 0; b < nb; ++b) {
+                        const auto mean = sum[b] / static_cast<double>(replicas);
+                        const auto var = (sumSq[b] - mean * sum[b]) / static_cast<double>(replicas - 1);
+                        ret.errors[base + b] = static_cast<float>(std::sqrt(std::max(var, 0.0)) / mean);
+                    }
+                }
+            }
+        );
+
+        return ret;
+    } // <-- build()
+
+    /// \brief Grid points along axis `d`: HV, left, right, border
+    const std::vector<Real>& axis(std::size_t d) const { return axes.at(d); }
+    /// \brief Ratio logarithms at grid points, border index fastest
+    const std::vector<float>& getValues() const { return values; }
+    /// \brief Whether statistical errors were estimated
+    bool hasErrors() const { return !errors.empty(); }
+
+    /**
+     * \brief Interpolate the ratio at a point
+     *
+     * \throws std::runtime_error if the point is outside the grid
+     */
+    RatioEstimate query(Real hv, Real left, Real right, Real border) const {
+        const std::array<Real, dims> point{ hv, left, right, border };
+
+        std::array<std::size_t, dims> lo{};
+        std::array<double, dims> t{};
+        for (std::size_t d = 0; d < dims; ++d) {
+            const auto& x = axes[d];
+            if (point[d] < x.front() || point[d] > x.back()) {
+                throw std::runtime_error(
+                    "RatioTable query " + std::to_string(point[d]) + " is outside the grid axis ["
+                    + std::to_string(x.front()) + ", " + std::to_string(x.back()) + "]"
+                );
+            }
+            if (x.size() == 1) continue;
+
+            lo[d] = std::min<std::size_t>(std::upper_bound(x.begin(), x.end(), point[d]) - x.begin() - 1, x.size() - 2);
+            t[d] = (point[d] - x[lo[d]]) / (x[lo[d] + 1] - x[lo[d]]);
+        }
+
+        double logRatio = 0, relError = 0, logError = 0;
+        for (std::size_t corner = 0; corner < (1u << dims); ++corner) {
+            auto idx = lo;
+            double w = 1;
+            for (std::size_t d = 0; d < dims; ++d) {
+                const bool up = (corner >> d) & 1;
+                if (axes[d].size() == 1) {
+                    if (up) { w = 0; break; }
+                    continue;
+                }
+                idx[d] += up;
+                w *= up ? t[d] : 1 - t[d];
+            }
+            if (w == 0) continue;
+
+            const auto i = flatIndex(idx);
+            logRatio += w * values[i];
+            if (!errors.empty()) relError += w * errors[i];
+        }
+
+        for (std::size_t d = 0; d < dims; ++d) {
+            const auto& x = axes[d];
+            if (x.size() < 3) continue;
+
+            auto at = lo;
+            const auto f2lo = std::abs(secondDerivative(at, d));
+            at[d] += 1;
+            const auto f2hi = std::abs(secondDerivative(at, d));
+
+            const double h = x[lo[d] + 1] - x[lo[d]];
+            logError += std::max(f2lo, f2hi) / 2 * (t[d] * h) * ((1 - t[d]) * h);
+        }
+
+        RatioEstimate ret;
+        ret.ratio = std::exp(logRatio);
+        ret.statError = ret.ratio * relError;
+        ret.interpError = ret.ratio * std::expm1(logError);
+        return ret;
+    } // <-- query()
+
+    void save(BinaryWriter& w) const {
+        for (const auto& axis : axes) w.write(axis);
+        w.write(values);
+        w.write(errors);
+    } // <-- save()
+
+    static RatioTable load(BinaryReader& r) {
+        RatioTable ret;
+        std::size_t size = 1;
+        for (auto& axis : ret.axes) {
+            axis = r.readVector<Real>();
+            size *= axis.size();
+        }
+        ret.values = r.readVector<float>();
+        ret.errors = r.readVector<float>();
+
+        if (size == 0 || ret.values.size() != size || (!ret.errors.empty() && ret.errors.size() != size)) {
+            throw std::runtime_error("Corrupted serialized RatioTable");
+        }
+        return ret;
+    } // <-- load()
+}; // <-- class RatioTable
+
+} // <-- namespace edu28
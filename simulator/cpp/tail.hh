@@ -0,0 +1,205 @@
+#pragma once
+
+// Standard library
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "backend.hh"
+#include "base.hh"
+#include "budget.hh"
+#include "context.hh"
+#include "metrics.hh"
+#include "prob.hh"
+#include "rng.hh"
+#include "signals.hh"
+
+namespace edu28 {
+
+/**
+ * \brief Draws double overlap rolls conditioned on `integral >= border`
+ *
+ * Samples the joint distribution of a \ref SimulationContext restricted to
+ * the tail directly instead of rejecting ordinary rolls:
+ * 1. `(offset, amp1)` is drawn from its marginal given the event, for any
+ *    \ref OffsetDistribution of the context. Every amplitude grid interval
+ *    is split into \ref subdivisions cells, one \ref AliasTable picks an
+ *    `(offset, cell)` pair by its probability bound, and a uniform `amp1`
+ *    inside the cell is accepted with the ratio of its tail probability to
+ *    that bound. Tail probability grows monotonically with `amp1`, so the
+ *    bound is its value at a cell edge and almost every draw is accepted.
+ * 2. `amp2` is drawn by inverse CDF truncated to the values that still
+ *    reach the border.
+ *
+ * Every roll is a tail event (up to rounding of the integral). Roll number
+ * `i` draws from \ref CounterRng `(seed, i)`, same as the context.
+ */
+class TailSampler {
+    /// \brief Part of an amplitude grid interval for one offset
+    struct Cell {
+        Real lo;
+        Real width;
+        std::uint32_t offset;
+        /// \brief Tail probability bound over the cell
+        Real bound;
+    }; // <-- struct Cell
+
+    MixtureDistribution amplitudes;
+    Real border = 0;
+    int offsetMin = 0;
+    Real singleCoef = 0;
+    std::vector<Real> offsetCoef;
+
+    std::vector<Cell> cells;
+    AliasTable picker;
+    double tail = 0;
+
+    std::uint64_t seed = 0;
+    std::atomic<std::uint64_t> counter{ 0 };
+
+    /// \brief Tail probability given the first amplitude
+    Real given(std::size_t offset, Real amp1) const {
+        const auto rest = border - amp1 * singleCoef;
+        const auto c = offsetCoef[offset];
+        if (c > 0) return 1 - amplitudes.cdfAt(rest / c);
+        return rest <= 0;
+    } // <-- given()
+
+public:
+    /// \brief Cells per amplitude grid interval
+    static constexpr std::size_t subdivisions = 8;
+
+    /**
+     * \brief Tabulate the conditional distribution of `context`'s rolls
+     *
+     * \param seed - RNG seed
+     *
+     * \throws std::runtime_error if no roll can reach `border`
+     */
+    TailSampler(const SimulationContext& context, Real border, std::uint64_t seed)
+        : amplitudes(context.getAmplitudes()), border(border),
+          offsetMin(context.getOffsetMin()),
+          singleCoef(context.getSingleCoef()), offsetCoef(context.getOffsetCoef()),
+          tail(context.tailFraction(border)),
+          seed(seed)
+    {
+        const auto& components = amplitudes.getComponents();
+        const auto& weights = amplitudes.getWeights();
+        const auto& offsetPmf = context.getOffsets().probabilities();
+
+        double totalWeight = 0;
+        for (auto w : weights) totalWeight += w;
+
+        std::vector<Real> envelope;
+        for (std::size_t o = 0; o < offsetCoef.size(); ++o) {
+            if (offsetPmf[o] <= 0) continue;
+
+            for (std::size_t k = 0; k < components.size(); ++k) {
+                const auto& E = components[k].grid();
+                const auto& cdf = components[k].cdfTable();
+                const auto w = offsetPmf[o] * weights[k] / totalWeight;
+
+                for (std::size_t i = 0; i + 1 < E.size(); ++i) {
+                    const auto mass = cdf[i + 1] - cdf[i];
+                    if (mass <= 0) continue;
+
+                    const auto width = (E[i + 1] - E[i]) / subdivisions;
+                    for (std::size_t j = 0; j < subdivisions; ++j) {
+                        const auto lo = E[i] + static_cast<Real>(j) * width;
+                        const auto bound = std::max(given(o, lo), given(o, lo + width));
+                        if (bound <= 0) continue;
+
+                        cells.push_back(Cell{ lo, width, static_cast<std::uint32_t>(o), bound });
+                        envelope.push_back(static_cast<Real>(w * mass / subdivisions) * bound);
+                    }
+                }
+            }
+        }
+
+        if (cells.empty()) {
+            throw std::runtime_error("TailSampler border " + std::to_string(border) + " is above every possible integral");
+        }
+        picker = AliasTable(envelope);
+    } // <-- TailSampler()
+
+    /// \brief Same, seeded with the context's seed
+    TailSampler(const SimulationContext& context, Real border)
+        : TailSampler(context, border, context.getSeed())
+    {}
+
+    TailSampler(const TailSampler& other)
+        : amplitudes(other.amplitudes), border(other.border),
+          offsetMin(other.offsetMin), singleCoef(other.singleCoef), offsetCoef(other.offsetCoef),
+          cells(other.cells), picker(other.picker), tail(other.tail),
+          seed(other.seed), counter(other.counter.load())
+    {}
+
+    /// \brief Border the rolls are conditioned on
+    Real getBorder() const { return border; }
+    /// \brief RNG seed
+    std::uint64_t getSeed() const { return seed; }
+    /// \brief Number of the next roll
+    std::uint64_t getCounter() const { return counter.load(); }
+
+    /**
+     * \brief Probability of the event for an ordinary roll
+     *
+     * Weight of every conditional roll when estimating unconditional
+     * quantities, see \ref SimulationContext::tailFraction()
+     */
+    double tailFraction() const { return tail; }
+
+    /**
+     * \brief Perform conditional roll number `index`
+     */
+    DoubleOverlapRollResult roll(std::uint64_t index) const {
+        CounterRng rng(seed, index);
+
+        for (;;) {
+            const auto& cell = cells[picker(rng)];
+            const auto amp1 = cell.lo + rng.uniform() * cell.width;
+            if (rng.uniform() * cell.bound >= given(cell.offset, amp1)) continue;
+
+            // Truncated inverse CDF: only `amp2` that reach the border
+            const auto c = offsetCoef[cell.offset];
+            const auto from = (c > 0) ? amplitudes.cdfAt((border - amp1 * singleCoef) / c) : Real{ 0 };
+            const auto amp2 = amplitudes.quantile(from + rng.uniform() * (1 - from));
+
+            return DoubleOverlapRollResult{
+                offsetMin + static_cast<int>(cell.offset), amp1, amp2,
+                amp1 * singleCoef + amp2 * c
+            };
+        }
+    } // <-- roll()
+
+    /**
+     * \brief Perform `n` conditional rolls and return all results
+     *
+     * \throws MemoryBudgetExceeded if the results don't fit into the memory budget.
+     *         No roll numbers are used up then
+     */
+    BulkResult<DoubleOverlapRollResult> run(std::size_t n) {
+        detail::checkMemoryBudget(
+            detail::bytesFor<DoubleOverlapRollResult>(n),
+            "TailSampler::run() of " + std::to_string(n) + " rolls"
+        );
+
+        const auto first = counter.fetch_add(n);
+
+        BulkResult<DoubleOverlapRollResult> ret(n);
+        ret.metrics = detail::meteredParallelFor(
+            n,
+            [this, first, &ret] (std::size_t, std::size_t start, std::size_t end) {
+                for (std::size_t i = start; i < end; ++i) ret[i] = roll(first + i);
+            }
+        );
+        ret.metrics.peakBytes = ret.capacity() * sizeof(DoubleOverlapRollResult);
+
+        return ret;
+    } // <-- run()
+}; // <-- class TailSampler
+
+} // <-- namespace edu28
@@ -0,0 +1,228 @@
+#pragma once
+
+// Standard library
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#include "backend.hh"
+#include "base.hh"
+#include "context.hh"
+#include "hist.hh"
+#include "prob.hh"
+#include "response.hh"
+
+namespace edu28 {
+
+/**
+ * \brief True amplitude spectrum recovered by \ref Unfolder
+ */
+struct UnfoldResult {
+    /// \brief Amplitude grid
+    std::vector<Real> E;
+    /// \brief Probability of every grid bin, sums to 1
+    std::vector<Real> probabilities;
+    /// \brief Density on the grid, usable as `P` of a \ref Distribution
+    std::vector<Real> density;
+    /// \brief Measured spectrum predicted by the result, in counts
+    std::vector<Real> predicted;
+    /// \brief Multinomial log-likelihood of the measured spectrum
+    double logLikelihood = 0;
+    /// \brief Iterations performed
+    std::size_t iterations = 0;
+}; // <-- struct UnfoldResult
+
+/**
+ * \brief Richardson-Lucy (EM) unfolding of measured amplitude spectra
+ *
+ * A recorded event is single with probability `1 - pileup` and measures
+ * its amplitude `a`, or double and measures `a1 + a2 * r[offset]`, with
+ * `r = offsetCoef / singleCoef` of the setup context: the window integral
+ * in units of a single signal's one. Both amplitudes come from the true
+ * spectrum `f`, offsets from the context's \ref OffsetDistribution.
+ *
+ * Each iteration is the EM update for the latent event types and
+ * amplitudes, `f <- f * J^T (m / M(f)) / J^T 1` with `J` the Jacobian of
+ * the predicted spectrum `M`. Doubles landing past the grid are accounted
+ * for by `J^T 1`.
+ *
+ * The pile-up fraction is an input: a spectrum alone barely constrains it,
+ * since a slightly different `f` fits it about as well with another one.
+ * Take it from the count rate, e.g. \ref SimulationContext::tailFraction()
+ * of a trusted setup.
+ *
+ * The forward model is a \ref ResponseOperator whose bins are the amplitude
+ * cells in integral units. It only depends on the setup and the grid, so
+ * it's tabulated once and the object can unfold every spectrum of an HV scan
+ * measured on that grid.
+ */
+class Unfolder {
+    ResponseOperator response;
+    std::vector<Real> widths;
+
+    std::size_t size() const { return response.grid().size(); }
+
+    /// \brief Integral bins matching the amplitude cells of `E`
+    static Binning cellBinning(const SimulationContext& setup, const std::vector<Real>& E) {
+        if (E.size() < 2) throw std::runtime_error("Unfolder expects an ascending grid of at least two points");
+
+        std::vector<double> edges(E.size() + 1);
+        edges[0] = E[0] - (E[1] - E[0]) / 2.0;
+        for (std::size_t i = 1; i < E.size(); ++i) edges[i] = (E[i - 1] + E[i]) / 2.0;
+        edges.back() = E.back() + (E.back() - E[E.size() - 2]) / 2.0;
+        for (auto& e : edges) e *= setup.getSingleCoef();
+        return Binning::fromEdges(std::move(edges));
+    } // <-- cellBinning()
+
+    /**
+     * \brief Check the arguments of \ref run()
+     *
+     * \return number of events in `counts`
+     */
+    double checkInput(const std::vector<Real>& counts, double pileup) const {
+        if (counts.size() != size()) throw std::runtime_error("Unfolder expects counts on its grid");
+        if (!(pileup >= 0 && pileup < 1)) throw std::runtime_error("Unfolder expects a pile-up fraction in [0, 1)");
+        if (std::any_of(counts.begin(), counts.end(), [] (Real c) { return !(c >= 0); })) {
+            throw std::runtime_error("Unfolder expects non-negative counts");
+        }
+
+        double events = 0;
+        for (auto c : counts) events += c;
+        if (!(events > 0)) throw std::runtime_error("Unfolder expects a non-empty spectrum");
+        return events;
+    } // <-- checkInput()
+
+public:
+    /**
+     * \brief Tabulate where doubles land on the grid
+     *
+     * \param setup - shape, window and offset distribution. Its amplitudes are unused
+     * \param E     - amplitude grid of the measured spectra, ascending
+     *
+     * \throws std::runtime_error if the grid has less than two points or
+     *         isn't ascending, or the setup's single signal coefficient isn't positive
+     * \throws MemoryBudgetExceeded if the tables don't fit into the memory budget
+     */
+    Unfolder(const SimulationContext& setup, const std::vector<Real>& E) {
+        if (!(setup.getSingleCoef() > 0)) {
+            throw std::runtime_error("Unfolder expects a window that contains the signal");
+        }
+        if (std::adjacent_find(E.begin(), E.end(), std::greater_equal<Real>{}) != E.end()) {
+            throw std::runtime_error("Unfolder expects an ascending grid of at least two points");
+        }
+        response = ResponseOperator(setup, E, cellBinning(setup, E));
+
+        const auto& cells = response.cells();
+        widths.resize(E.size());
+        for (std::size_t i = 0; i < E.size(); ++i) widths[i] = static_cast<Real>(cells[i + 1] - cells[i]);
+    } // <-- Unfolder()
+
+    /// \brief Forward model of the unfolding
+    const ResponseOperator& getResponse() const { return response; }
+
+    /// \brief Amplitude grid
+    const std::vector<Real>& grid() const { return response.grid(); }
+
+    /**
+     * \brief Unfold one measured spectrum
+     *
+     * \param counts        - measured counts on the grid
+     * \param pileup        - fraction of events that are double, including
+     *                        doubles that land past the grid
+     * \param maxIterations - iteration limit
+     * \param tolerance     - stop once the log-likelihood changes by less than
+     *                        this times the number of events
+     *
+     * \throws std::runtime_error if the sizes don't match, a count is negative,
+     *         there are no counts or `pileup` isn't in [0, 1)
+     */
+    UnfoldResult run(
+        const std::vector<Real>& counts,
+        double pileup,
+        std::size_t maxIterations = 1000, double tolerance = 1e-9
+    ) const {
+        const auto n = size();
+        const auto events = checkInput(counts, pileup);
+
+        // Start from the measured spectrum itself
+        std::vector<double> f(n);
+        for (std::size_t i = 0; i < n; ++i) f[i] = (counts[i] + 0.5) / (events + 0.5 * static_cast<double>(n));
+
+        UnfoldResult ret;
+        std::vector<double> M, q(n), back, sensitivity;
+        double previous = -std::numeric_limits<double>::infinity();
+
+        for (ret.iterations = 0; ret.iterations < maxIterations; ++ret.iterations) {
+            M = response.apply(f, pileup);
+
+            double total = 0;
+            for (auto x : M) total += x;
+
+            double logLikelihood = 0;
+            for (std::size_t y = 0; y < n; ++y) {
+                q[y] = (M[y] > 0) ? counts[y] / M[y] : 0;
+                if (counts[y] > 0 && M[y] > 0) logLikelihood += counts[y] * std::log(M[y] / total);
+            }
+            ret.logLikelihood = logLikelihood;
+            if (std::abs(logLikelihood - previous) < tolerance * events) break;
+            previous = logLikelihood;
+
+            response.backProject(f, q, pileup, back, sensitivity);
+
+            double norm = 0;
+            for (std::size_t a = 0; a < n; ++a) {
+                f[a] *= (sensitivity[a] > 0) ? back[a] / sensitivity[a] : 0;
+                norm += f[a];
+            }
+            for (auto& x : f) x /= norm;
+        }
+
+        M = response.apply(f, pileup);
+        double total = 0;
+        for (auto x : M) total += x;
+
+        ret.E = grid();
+        ret.probabilities.resize(n);
+        ret.density.resize(n);
+        ret.predicted.resize(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            ret.probabilities[i] = static_cast<Real>(f[i]);
+            ret.density[i] = static_cast<Real>(f[i] / widths[i]);
+            ret.predicted[i] = static_cast<Real>(M[i] / total * events);
+        }
+
+        return ret;
+    } // <-- run()
+
+    /**
+     * \brief Unfold every spectrum of a scan in parallel, one spectrum per task
+     *
+     * See \ref run() for the arguments
+     *
+     * \throws std::runtime_error if any spectrum fails the checks of \ref run().
+     *         All are checked before unfolding starts
+     */
+    std::vector<UnfoldResult> runAll(
+        const std::vector<std::vector<Real>>& counts,
+        double pileup,
+        std::size_t maxIterations = 1000, double tolerance = 1e-9
+    ) const {
+        for (const auto& c : counts) checkInput(c, pileup);
+
+        std::vector<UnfoldResult> ret(counts.size());
+
+        detail::parallelFor(
+            counts.size(), counts.size(),
+            [&] (std::size_t, std::size_t start, std::size_t end) {
+                for (auto i = start; i < end; ++i) ret[i] = run(counts[i], pileup, maxIterations, tolerance);
+            }
+        );
+
+        return ret;
+    } // <-- runAll()
+}; // <-- class Unfolder
+
+} // <-- namespace edu28
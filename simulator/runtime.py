@@ -0,0 +1,101 @@
+"""!
+\brief Core runtime for batch workers: the C++ extension and a thin numpy API
+
+Imports nothing but numpy. A compiled extension that is up to date with its
+sources is loaded directly; torch is only imported when it has to be built.
+Build it ahead of time on the worker image with `python -m simulator build`.
+"""
+
+import numpy as np
+
+from . import cpp
+
+def get():
+    """!
+    \brief C++ extension interface, see `cpp.get`
+    """
+    return cpp.get()
+
+def rollDoubleOverlap(E, P, signal, intLeft, intRight, numRolls, offsetMin=0, offsetMax=42, offsets=None):
+    """!
+    \brief Run `numRolls` double overlap simulations
+
+    \param offsets - `OffsetDistribution`, replaces the uniform [offsetMin, offsetMax] if given
+
+    \return ( `(numRolls, 4)` array of `offset, amp1, amp2, integral` rows, run metrics )
+
+    \throws MemoryError if the result doesn't fit into the memory budget
+    """
+    module = get()
+    if not module.fitsMemoryBudget(numRolls * 4 * module.realDtype.itemsize):
+        raise module.MemoryBudgetExceeded(f"{numRolls} rolls don't fit into the memory budget")
+
+    out = np.empty(( numRolls, 4 ), dtype=module.realDtype)
+    if offsets is None:
+        offsets = module.OffsetDistribution.uniform(offsetMin, offsetMax)
+    metrics = module.rollDoubleOverlapBulkInto(out, E, P, signal, intLeft, intRight, offsets)
+    return out, metrics
+
+def rollSingle(E, P, signal, intLeft, intRight, numRolls):
+    """!
+    \brief Run `numRolls` single signal simulations
+
+    \return ( integrals array, run metrics )
+    """
+    bulk = get().rollSingleBulk(numRolls, E, P, signal, intLeft, intRight)
+    return np.asarray(bulk), bulk.metrics
+
+def context(E, P, signal, intLeft, intRight, offsetMin=0, offsetMax=42, seed=None, offsets=None):
+    """!
+    \brief Precomputed double overlap simulation, see `SimulationContext`
+
+    \param offsets - `OffsetDistribution`, replaces the uniform [offsetMin, offsetMax] if given
+    """
+    module = get()
+    if offsets is not None:
+        return module.SimulationContext(module.Distribution(E, P), signal, intLeft, intRight, offsets, seed)
+    if seed is None:
+        return module.SimulationContext(E, P, signal, intLeft, intRight, offsetMin, offsetMax)
+    return module.SimulationContext(E, P, signal, intLeft, intRight, offsetMin, offsetMax, seed)
+
+def histogram(ctx, numRolls, bins, lo=None, hi=None):
+    """!
+    \brief Histogram `numRolls` integrals of a context in constant memory
+
+    \return ( bin edges, bin counts ), same as `np.histogram`
+    """
+    hist = ctx.histogram(numRolls, bins) if lo is None else ctx.histogram(numRolls, bins, lo, hi)
+    return hist.edges, hist.counts
+
+def ratio(ctx, numRolls, border):
+    """!
+    \brief Pile-up ratio of `numRolls` integrals of a context, see `BorderCounts.ratio`
+    """
+    return ctx.ratio(numRolls, border)
+
+def bootstrapRatio(ctx, E, counts, replicas, border, numRolls=0, seed=None):
+    """!
+    \brief Spread of the pile-up ratio over Poisson replicas of a measured spectrum
+
+    \param counts   - raw spectrum counts, see `util.loadExperimentalSignal(normalize=False)`
+    \param numRolls - rolls per replica. Zero computes ratios without rolling
+
+    \return `BootstrapResult` with the ratio of every replica
+    """
+    bootstrap = get().SpectrumBootstrap(E, counts, seed)
+    return bootstrap.ratios(ctx, replicas, border, numRolls)
+
+def unfold(ctx, E, counts, pileup, maxIterations=1000, tolerance=1e-9):
+    """!
+    \brief True amplitude spectrum of a measured one, see `Unfolder`
+
+    \param ctx    - setup with the shape, window and offsets of the measurement
+    \param counts - measured counts on `E`, or a list of spectra on `E` to unfold in parallel
+    \param pileup - fraction of events that are double
+
+    \return `UnfoldResult`, or a list of them
+    """
+    unfolder = get().Unfolder(ctx, E)
+    if len(counts) > 0 and np.ndim(counts[0]) > 0:
+        return unfolder.runAll(counts, pileup, maxIterations, tolerance)
+    return unfolder.run(counts, pileup, maxIterations, tolerance)
@@ -2,9 +2,7 @@
 \brief Submodule dedicated to signals manipulation
 """
 
-from numba import njit
-import numpy             as np
-import matplotlib.pyplot as plt
+import numpy as np
 
 from . import cpp
 from . import util
@@ -26,26 +24,44 @@ class SignalTester:
         self.signal = signal
         self.result = None
     
-    def run(self, offsetLeft, offsetRight, numRolls=10_000_000):
+    def run(self, offsetLeft, offsetRight, numRolls=10_000_000, spillDir=None, offsets=None):
         """!
         \brief Run `numRolls` double overlap simulations
         
+        Results are written straight into the result array. If it doesn't fit
+        into the C++ module's memory budget, it's memory-mapped to a temporary
+        file instead
+
         \param offsetLeft  - left border of integration offset relative to 9
         \param offsetRight - right border of integration offset relative to 9
         \param numRolls    - number of rolls
+        \param spillDir    - directory for the memory-mapped file, system default if `None`
+        \param offsets     - `OffsetDistribution` of the second signal's peak, uniform in [0, 42] if `None`
+
+        \throws MemoryError if the result fits neither into the budget nor on disk
         """
+        module = cpp.get()
+        shape = ( numRolls, 4 )
+
+        if module.fitsMemoryBudget(numRolls * 4 * module.realDtype.itemsize):
+            data = np.empty(shape, dtype=module.realDtype)
+        else:
+            data = util.spillArray(shape, module.realDtype, spillDir)
+
+        if offsets is None:
+            offsets = module.OffsetDistribution.uniform(0, 42)
+
+        metrics = module.rollDoubleOverlapBulkInto(
+            data,
+            self.E, self.P, self.signal,
+            offsetLeft, offsetRight,
+            offsets
+        )
         self.result = {
-            "left":  offsetLeft,
-            "right": offsetRight,
-            "data":  np.array(
-                cpp.get().toList(
-                    cpp.get().rollDoubleOverlapBulk(
-                        numRolls,
-                        self.E, self.P, self.signal,
-                        offsetLeft, offsetRight
-                    )
-                )
-            )
+            "left":    offsetLeft,
+            "right":   offsetRight,
+            "data":    data,
+            "metrics": metrics.asDict()
         }
     
     def runSingle(self, offsetLeft, offsetRight, numRolls=10_000_000):
@@ -55,13 +71,16 @@ class SignalTester:
         \param offsetLeft  - left border of integration offset relative to 9
         \param offsetRight - right border of integration offset relative to 9
         \param numRolls    - number of rolls
+
+        \throws MemoryError if the result doesn't fit into the C++ module's memory budget
         """
+        bulk = cpp.get().rollSingleBulk(numRolls, self.E, self.P, self.signal, offsetLeft, offsetRight)
         self.result = {
             "left":       offsetLeft,
             "right":      offsetRight,
-            "dataSingle": np.array(
-                cpp.get().rollSingleBulk(numRolls, self.E, self.P, self.signal, offsetLeft, offsetRight)
-            )
+            # A view, the results aren't copied
+            "dataSingle": np.asarray(bulk),
+            "metrics":    bulk.metrics.asDict()
         }
     
     def plot(self, bins=1001, figsize=(10, 10), dump=None, dumpSep=' ', log=False, draw=True):
@@ -84,6 +103,8 @@ class SignalTester:
         hist = None
         
         if draw:
+            import matplotlib.pyplot as plt
+
             if "data" in self.result:
                 fig, ax = plt.subplots(2, 2, squeeze=True, figsize=figsize)
                 for i in range(2):
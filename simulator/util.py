@@ -7,8 +7,10 @@
 \brief The file describes various utility functions used in the project
 """
 
-import numpy             as np
-import matplotlib.pyplot as plt
+import shutil
+import tempfile
+
+import numpy as np
 
 from . import cpp
 
@@ -19,13 +21,34 @@ def plotSignals(*signals, **namedSignals):
     All arguments are treated as signals in format described above.
     Keyword arguments use their keywords as plot titles
     """
+    import matplotlib.pyplot as plt
+
     for idx, signal in enumerate(signals):
         plt.plot(signal[0], signal[1], label=f"Signal {idx}")
     for name, signal in namedSignals.items():
         plt.plot(signal[0], signal[1], label=name)
     plt.legend()
 
-def loadExperimentalSignal(filename, separator='\t', trimLength = 20):
+def loadSignalShape(filename, separator='\t'):
+    """!
+    \brief Loads a signal shape file (like `task/Shape_Etalon.txt`)
+
+    \param filename  - shape file name
+    \param separator - file column separator
+    """
+    signal = ( [], [] )
+    with open(filename) as shapeFile:
+        for line in shapeFile.readlines():
+            if not line.strip():
+                continue
+
+            point = line.split(separator)
+            for i in range(2):
+                signal[i].append(float(point[i]))
+
+    return ( np.array(signal[0]), np.array(signal[1]) )
+
+def loadExperimentalSignal(filename, separator='\t', trimLength = 20, normalize = True):
     """!
     \brief Loads a signal shape from Numass experimental data file
 
@@ -34,6 +57,7 @@ def loadExperimentalSignal(filename, separator='\t', trimLength = 20):
     \param filename   - data file name
     \param separator  - file column separator
     \param trimLength - trim the signal after this value. Set to None to disable
+    \param normalize  - normalize `P`. Otherwise return raw counts, e.g. for `SpectrumBootstrap`
     """
     signal = ( [], [] )
     with open(filename) as sigFile:
@@ -60,6 +84,9 @@ def loadExperimentalSignal(filename, separator='\t', trimLength = 20):
         P = P[E <= trimLength]
         E = E[E <= trimLength]
 
+    if not normalize:
+        return ( E, P )
+
     return ( E, cpp.get().probNormalize(E, P) )
 
 def readHistFile(filename, separator=' '):
@@ -84,6 +111,45 @@ def readHistFile(filename, separator=' '):
         
         return ret
 
+def readSparseHistFile(filename, separator=' '):
+    """!
+    \brief Reads a sparse histogram file (see `SparseHistogram.saveText`) into dense arrays
+
+    Doesn't need the C++ extension
+
+    \param filename  - histogram file name
+    \param separator - column separator
+
+    \return ( bin edges, bin counts ), same as `np.histogram`
+    """
+    with open(filename) as histFile:
+        header = histFile.readline().split(separator)
+        header = [ h for h in header if h.strip() ]
+        if len(header) != 5 or header[0] != "#":
+            raise RuntimeError(f"{filename} is not a sparse histogram file")
+
+        bins = int(header[2])
+        lo, hi = float(header[3]), float(header[4])
+
+        if header[1] == "sparse":
+            edges = np.linspace(lo, hi, bins + 1)
+        elif header[1] == "sparse-log":
+            edges = np.geomspace(lo, hi, bins + 1)
+        elif header[1] == "sparse-edges":
+            edges = np.array([ float(e) for e in histFile.readline().split(separator)[1:] if e.strip() ])
+        else:
+            raise RuntimeError(f"{filename} is not a sparse histogram file")
+
+        counts = np.zeros(bins, dtype=np.uint64)
+        for line in histFile.readlines():
+            if not line.strip():
+                continue
+
+            point = line.split(separator)
+            counts[int(point[0])] = int(point[2])
+
+        return ( edges, counts )
+
 def analyzeHistFile(filename, border, separator=' '):
     """!
     \brief Reads a histogram file and determines how many matches hit left or right of the border
@@ -108,3 +174,25 @@ def analyzeHistFile(filename, border, separator=' '):
                 right += float(point[1])
         
         return (left, right)
+
+def spillArray(shape, dtype, directory=None):
+    """!
+    \brief Creates an array backed by an anonymous temporary file
+
+    The file is deleted once the array is garbage collected
+
+    \param shape     - array shape
+    \param dtype     - array type
+    \param directory - directory for the file, system default if `None`
+
+    \throws MemoryError if there's not enough free disk space
+    """
+    directory = tempfile.gettempdir() if directory is None else directory
+    size = int(np.prod(shape)) * np.dtype(dtype).itemsize
+
+    free = shutil.disk_usage(directory).free
+    if size > free:
+        raise MemoryError(f"Spilling {size >> 20} MiB to {directory} failed: only {free >> 20} MiB free")
+
+    with tempfile.TemporaryFile(dir=directory) as backing:
+        return np.memmap(backing, dtype=dtype, mode="w+", shape=shape)
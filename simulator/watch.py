@@ -0,0 +1,382 @@
+"""!
+\brief Incremental ratio-vs-HV table over a growing data directory
+
+New `p*(30s)(HV1=*)` run files are picked up as they land (inotify on
+Linux, directory polling elsewhere), hashed, and the pile-up ratio of their
+HV point is recomputed. Runs of the same HV are summed into one spectrum;
+byte-identical copies of a run count once. Files whose contents didn't
+change are skipped, so restarting the watcher only recomputes what's new,
+and removed files drop out of their point.
+"""
+
+import ctypes
+import ctypes.util
+import hashlib
+import json
+import os
+import queue
+import re
+import select
+import struct
+import threading
+import time
+
+import numpy as np
+
+from . import cpp
+from . import util
+
+## \brief Run file name: `p<index>(<seconds>s)(HV1=<voltage>)`, optionally with a `(<copy>)` suffix
+RUN_FILE_PATTERN = re.compile(r"^p(\d+)\((\d+)s\)\(HV1=(\d+(?:\.\d+)?)\)(?:\(\d+\))?$")
+
+def parseRunName(filename):
+    """!
+    \brief HV of a run file, or `None` if the name isn't a run file
+    """
+    match = RUN_FILE_PATTERN.match(os.path.basename(filename))
+    return float(match.group(3)) if match else None
+
+def fileHash(path):
+    """!
+    \brief SHA-256 of the file contents
+    """
+    digest = hashlib.sha256()
+    with open(path, "rb") as f:
+        for block in iter(lambda: f.read(1 << 20), b""):
+            digest.update(block)
+    return digest.hexdigest()
+
+def uniqueRuns(paths, hashes=None):
+    """!
+    \brief `paths` without byte-identical copies of an earlier one
+
+    \param hashes - known `fileHash` of some paths, the rest are hashed
+    """
+    seen = set()
+    ret = []
+    for path in paths:
+        digest = hashes[path] if hashes and path in hashes else fileHash(path)
+        if digest not in seen:
+            seen.add(digest)
+            ret.append(path)
+    return ret
+
+def sumRuns(paths, log=print):
+    """!
+    \brief Sum the raw counts of several runs of one HV
+
+    Runs with an amplitude grid different from the first one are skipped
+
+    \return ( E, counts )
+    """
+    E, counts = None, None
+    for path in paths:
+        runE, runCounts = util.loadExperimentalSignal(path, normalize=False)
+        if E is None:
+            E, counts = runE, np.array(runCounts, dtype=float)
+        elif np.array_equal(E, runE):
+            counts += runCounts
+        else:
+            log(f"Skipping {path}: its amplitude grid differs from the other runs")
+    return E, counts
+
+def loadHvSpectra(directory, log=print):
+    """!
+    \brief Summed spectra of every HV point in a data directory
+
+    Copies of a run, e.g. `p30(30s)(HV1=16000)(1)`, are only summed if their
+    contents differ
+
+    \return ( HVs ascending, grids, counts ), see `sumRuns`
+    """
+    byHv = {}
+    for name in sorted(os.listdir(directory)):
+        hv = parseRunName(name)
+        if hv is not None and os.path.isfile(os.path.join(directory, name)):
+            byHv.setdefault(hv, []).append(os.path.join(directory, name))
+
+    hvs = sorted(byHv)
+    spectra = [ sumRuns(uniqueRuns(byHv[hv]), log) for hv in hvs ]
+    return hvs, [ E for E, _ in spectra ], [ counts for _, counts in spectra ]
+
+class InotifyWatcher:
+    """!
+    \brief Names of files written, moved or removed in a directory, via inotify through ctypes
+
+    \throws OSError if inotify isn't available
+    """
+    IN_CLOSE_WRITE = 0x00000008
+    IN_MOVED_FROM  = 0x00000040
+    IN_MOVED_TO    = 0x00000080
+    IN_DELETE      = 0x00000200
+    IN_NONBLOCK    = 0o4000
+    EVENT_HEADER   = struct.Struct("iIII")
+
+    def __init__(self, directory):
+        libc = ctypes.CDLL(ctypes.util.find_library("c"), use_errno=True)
+        if not hasattr(libc, "inotify_init1"):
+            raise OSError("inotify is not available")
+
+        self.fd = libc.inotify_init1(self.IN_NONBLOCK)
+        if self.fd < 0:
+            raise OSError(ctypes.get_errno(), "inotify_init1 failed")
+
+        if libc.inotify_add_watch(
+            self.fd, os.fsencode(directory),
+            self.IN_CLOSE_WRITE | self.IN_MOVED_FROM | self.IN_MOVED_TO | self.IN_DELETE
+        ) < 0:
+            os.close(self.fd)
+            raise OSError(ctypes.get_errno(), f"Can't watch {directory}")
+
+    def wait(self, timeout):
+        """!
+        \brief Names of the files finished or removed within `timeout` seconds, possibly none
+        """
+        ready, _, _ = select.select([ self.fd ], [], [], timeout)
+        if not ready:
+            return []
+
+        data = os.read(self.fd, 1 << 16)
+        names = []
+        pos = 0
+        while pos < len(data):
+            _, _, _, length = self.EVENT_HEADER.unpack_from(data, pos)
+            pos += self.EVENT_HEADER.size
+            names.append(os.fsdecode(data[pos:pos + length].rstrip(b"\0")))
+            pos += length
+        return names
+
+    def close(self):
+        os.close(self.fd)
+
+class PollingWatcher:
+    """!
+    \brief Same interface as `InotifyWatcher`, comparing directory listings
+    """
+    def __init__(self, directory):
+        self.directory = directory
+        self.seen = self.__listing()
+
+    def __listing(self):
+        ret = {}
+        for entry in os.scandir(self.directory):
+            if entry.is_file():
+                stat = entry.stat()
+                ret[entry.name] = ( stat.st_mtime_ns, stat.st_size )
+        return ret
+
+    def wait(self, timeout):
+        time.sleep(timeout)
+        listing = self.__listing()
+        changed = [ name for name, stamp in listing.items() if self.seen.get(name) != stamp ]
+        changed += [ name for name in self.seen if name not in listing ]
+        self.seen = listing
+        return changed
+
+    def close(self):
+        pass
+
+class RatioTable:
+    """!
+    \brief Ratio-vs-HV table kept up to date with the run files of a directory
+
+    State (file hashes and per-HV results) lives in a JSON file next to the
+    table, so an interrupted campaign resumes without recomputing
+    """
+    def __init__(self, directory, signal, left, right, border,
+                 offsetMin=0, offsetMax=42, rolls=0, seed=0,
+                 output=None, log=print):
+        """!
+        \param signal - signal shape, see `util.loadSignalShape`
+        \param rolls  - rolls per HV point. Zero computes ratios without rolling
+        \param output - table file, `ratios.tsv` in `directory` by default
+        """
+        self.directory = directory
+        self.signal = signal
+        self.left = left
+        self.right = right
+        self.border = border
+        self.offsetMin = offsetMin
+        self.offsetMax = offsetMax
+        self.rolls = rolls
+        self.seed = seed
+        self.output = output or os.path.join(directory, "ratios.tsv")
+        self.statePath = self.output + ".json"
+        self.log = log
+        # `update` runs on the watching thread, `compute` and `save` on the worker
+        self.lock = threading.Lock()
+
+        # file name -> { "hash", "hv" }, HV string -> { "files", "ratio", ... }
+        self.files = {}
+        self.points = {}
+        if os.path.exists(self.statePath):
+            with open(self.statePath) as f:
+                state = json.load(f)
+            if state.get("setup") == self.__setup():
+                self.files = state["files"]
+                self.points = state["points"]
+
+    def __setup(self):
+        return {
+            "left": self.left, "right": self.right, "border": self.border,
+            "offsetMin": self.offsetMin, "offsetMax": self.offsetMax,
+            "rolls": self.rolls, "seed": self.seed
+        }
+
+    def update(self, name):
+        """!
+        \brief Rehash a file and return its HV if that point needs recomputing
+
+        A removed file is forgotten. A byte-identical copy of another run of
+        the same HV is recorded but doesn't change the point
+        """
+        hv = parseRunName(name)
+        if hv is None:
+            return None
+
+        path = os.path.join(self.directory, name)
+        if not os.path.isfile(path):
+            with self.lock:
+                entry = self.files.pop(name, None)
+            return entry["hv"] if entry else None
+
+        digest = fileHash(path)
+        with self.lock:
+            previous = self.files.get(name, {}).get("hash")
+            if previous == digest:
+                return None
+
+            duplicate = any(
+                entry["hv"] == hv and entry["hash"] == digest
+                for other, entry in self.files.items() if other != name
+            )
+            self.files[name] = { "hash": digest, "hv": hv }
+        return None if duplicate and previous is None else hv
+
+    def compute(self, hv):
+        """!
+        \brief Recompute the ratio of an HV point from the sum of its distinct runs
+
+        Files removed since they were recorded are dropped first, and the
+        point with them if none is left
+        """
+        with self.lock:
+            for name in [ name for name in self.files if not os.path.isfile(os.path.join(self.directory, name)) ]:
+                del self.files[name]
+
+            hashes = {
+                os.path.join(self.directory, name): entry["hash"]
+                for name, entry in self.files.items() if entry["hv"] == hv
+            }
+            if not hashes:
+                self.points.pop(str(hv), None)
+                self.log(f"HV={hv:g}: no runs left, removed")
+                return
+
+        paths = uniqueRuns(sorted(hashes), hashes)
+        names = [ os.path.basename(path) for path in paths ]
+        E, counts = sumRuns(paths, self.log)
+
+        module = cpp.get()
+        context = module.SimulationContext(
+            module.Distribution(E, counts), self.signal,
+            self.left, self.right, self.offsetMin, self.offsetMax, self.seed
+        )
+        ratio = context.analyticRatio(self.border) if self.rolls == 0 else context.ratio(self.rolls, self.border)
+
+        with self.lock:
+            self.points[str(hv)] = {
+                "hv":     hv,
+                "files":  names,
+                "counts": float(counts.sum()),
+                "ratio":  float(ratio)
+            }
+        self.log(f"HV={hv:g}: ratio={ratio:.6g} from {len(names)} run(s)")
+
+    def save(self):
+        """!
+        \brief Write the table and the state, replacing the old ones atomically
+        """
+        with self.lock:
+            rows = sorted(self.points.values(), key=lambda p: p["hv"])
+            state = { "setup": self.__setup(), "files": dict(self.files), "points": dict(self.points) }
+
+        with open(self.output + ".tmp", "w") as f:
+            f.write("# hv\tratio\tcounts\truns\n")
+            for p in rows:
+                f.write(f"{p['hv']:g}\t{p['ratio']:.9g}\t{p['counts']:g}\t{len(p['files'])}\n")
+        os.replace(self.output + ".tmp", self.output)
+
+        with open(self.statePath + ".tmp", "w") as f:
+            json.dump(state, f, indent=1)
+        os.replace(self.statePath + ".tmp", self.statePath)
+
+def watch(table, interval=1.0, once=False, polling=False):
+    """!
+    \brief Keep `table` up to date with its directory
+
+    Files are hashed as they arrive. Computations are queued to one worker
+    thread; the C++ side spreads each of them over the shared pool, so
+    watching never waits for a computation to finish
+
+    \param interval - polling period and inotify wake-up timeout, seconds
+    \param once     - process the files already there and return
+    \param polling  - don't try inotify
+    """
+    pending = queue.Queue()
+
+    def worker():
+        while True:
+            items = [ pending.get() ]
+            # Coalesce bursts, e.g. several runs of one HV landing at once
+            while True:
+                try:
+                    items.append(pending.get_nowait())
+                except queue.Empty:
+                    break
+
+            stop = None in items
+            hvs = set(items) - { None }
+
+            for hv in sorted(hvs):
+                try:
+                    table.compute(hv)
+                except Exception as e:
+                    table.log(f"HV={hv:g} failed: {e}")
+            if hvs:
+                table.save()
+            if stop:
+                return
+
+    thread = threading.Thread(target=worker, daemon=True)
+    thread.start()
+
+    def enqueue(names):
+        for hv in { table.update(name) for name in names } - { None }:
+            pending.put(hv)
+
+    watcher = None
+    try:
+        # Start watching before the initial scan so that nothing lands in between
+        if not once:
+            try:
+                watcher = PollingWatcher(table.directory) if polling else InotifyWatcher(table.directory)
+            except OSError as e:
+                table.log(f"inotify unavailable ({e}), polling every {interval} s")
+                watcher = PollingWatcher(table.directory)
+
+        # Recorded files are rescanned too: one removed while nobody watched
+        # still has to leave its point
+        with table.lock:
+            recorded = set(table.files)
+        enqueue(sorted(set(os.listdir(table.directory)) | recorded))
+
+        while watcher is not None:
+            enqueue(watcher.wait(interval))
+    except KeyboardInterrupt:
+        pass
+    finally:
+        if watcher is not None:
+            watcher.close()
+        pending.put(None)
+        thread.join()
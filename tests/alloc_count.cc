@@ -0,0 +1,157 @@
+/**
+ * \brief Allocation regression test for the roll paths
+ *
+ * Replaces the global `operator new` with a counting one and checks that
+ * single rolls don't allocate at all and that bulk runs of 2M rolls
+ * allocate about as often as runs of 200k: for the result buffer and job
+ * bookkeeping only, never per roll. Exits with a non-zero status otherwise.
+ */
+
+// Standard library
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <new>
+#include <vector>
+
+#include "context.hh"
+#include "signals.hh"
+
+namespace {
+
+    std::atomic<std::size_t> allocations{ 0 };
+
+    void* countedAlloc(std::size_t bytes, std::size_t alignment) {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        if (bytes == 0) bytes = 1;
+        void* p = nullptr;
+        if (alignment <= alignof(std::max_align_t)) {
+            p = std::malloc(bytes);
+        } else if (posix_memalign(&p, alignment, bytes) != 0) {
+            p = nullptr;
+        }
+        return p;
+    } // <-- countedAlloc()
+
+    /**
+     * \brief Release memory from \ref countedAlloc()
+     *
+     * Kept out of line: once `free()` is inlined into a caller that got the
+     * pointer from `operator new`, GCC reports a mismatched deallocation
+     */
+    [[gnu::noinline]] void countedFree(void* p) noexcept {
+        std::free(p);
+    } // <-- countedFree()
+
+} // <-- namespace
+
+void* operator new(std::size_t bytes) {
+    if (void* p = countedAlloc(bytes, 0)) return p;
+    throw std::bad_alloc();
+}
+void* operator new[](std::size_t bytes) { return ::operator new(bytes); }
+void* operator new(std::size_t bytes, std::align_val_t a) {
+    if (void* p = countedAlloc(bytes, static_cast<std::size_t>(a))) return p;
+    throw std::bad_alloc();
+}
+void* operator new[](std::size_t bytes, std::align_val_t a) { return ::operator new(bytes, a); }
+void* operator new(std::size_t bytes, const std::nothrow_t&) noexcept { return countedAlloc(bytes, 0); }
+void* operator new[](std::size_t bytes, const std::nothrow_t&) noexcept { return countedAlloc(bytes, 0); }
+
+void operator delete(void* p) noexcept { countedFree(p); }
+void operator delete[](void* p) noexcept { countedFree(p); }
+void operator delete(void* p, std::size_t) noexcept { countedFree(p); }
+void operator delete[](void* p, std::size_t) noexcept { countedFree(p); }
+void operator delete(void* p, std::align_val_t) noexcept { countedFree(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { countedFree(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { countedFree(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { countedFree(p); }
+
+namespace {
+
+    /// \brief Number of allocations made by `func()`
+    std::size_t countAllocations(const std::function<void()>& func) {
+        const auto before = allocations.load();
+        func();
+        return allocations.load() - before;
+    } // <-- countAllocations()
+
+    /// \brief Allocations a run may vary by: pool and scheduler bookkeeping
+    constexpr std::size_t slack = 16;
+
+    int failures = 0;
+
+    /**
+     * \brief Report a check, counting failures
+     *
+     * \param exact - every roll is counted, so any allocation fails. Bulk runs
+     *                may allocate a few times per run but not per roll
+     */
+    void check(const char* what, std::size_t small, std::size_t large, bool exact) {
+        const bool ok = exact ? (small == 0 && large == 0) : (large <= small + slack);
+        std::printf("%-28s %6zu %6zu  %s\n", what, small, large, ok ? "ok" : "FAILED");
+        if (!ok) ++failures;
+    } // <-- check()
+
+} // <-- namespace
+
+int main() {
+    using namespace edu28;
+
+    // Both above the pooled buffer size, where the result is allocated the same way
+    constexpr std::size_t small = 200'000;
+    constexpr std::size_t large = 2'000'000;
+
+    std::vector<Real> E(100), P(100);
+    for (std::size_t i = 0; i < E.size(); ++i) {
+        E[i] = static_cast<Real>(i) / 10;
+        P[i] = std::exp(-E[i]);
+    }
+    P = probNormalize(E, P);
+
+    std::vector<Real> X(100), Y(100);
+    for (std::size_t i = 0; i < X.size(); ++i) {
+        X[i] = static_cast<Real>(i);
+        Y[i] = std::exp(-std::abs(X[i] - 9) / 3);
+    }
+    const Signal signal{ X, Y };
+
+    SimulationContext context(E, P, signal, 2, 10, 0, 42, 1);
+
+    // Start the pool, thread-local RNGs and the buffer pool first
+    rollSingleBulk(large, E, P, signal, 2, 10);
+    rollDoubleOverlapBulk(large, E, P, signal, 2, 10);
+    context.run(large);
+
+    std::printf("%-28s %6s %6s\n", "allocations per", "200k", "2M");
+
+    const auto singles = [&] (std::size_t n) {
+        return countAllocations([&] { for (std::size_t i = 0; i < n; ++i) rollSingle(E, P, signal, 2, 10); });
+    };
+    check("rollSingle", singles(small), singles(large), true);
+
+    const auto doubles = [&] (std::size_t n) {
+        return countAllocations([&] { for (std::size_t i = 0; i < n; ++i) rollDoubleOverlap(E, P, signal, 2, 10); });
+    };
+    check("rollDoubleOverlap", doubles(small), doubles(large), true);
+
+    const auto singleBulk = [&] (std::size_t n) {
+        return countAllocations([&] { rollSingleBulk(n, E, P, signal, 2, 10); });
+    };
+    check("rollSingleBulk", singleBulk(small), singleBulk(large), false);
+
+    const auto doubleBulk = [&] (std::size_t n) {
+        return countAllocations([&] { rollDoubleOverlapBulk(n, E, P, signal, 2, 10); });
+    };
+    check("rollDoubleOverlapBulk", doubleBulk(small), doubleBulk(large), false);
+
+    const auto contextRun = [&] (std::size_t n) {
+        return countAllocations([&] { context.run(n); });
+    };
+    check("SimulationContext::run", contextRun(small), contextRun(large), false);
+
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+} // <-- main()